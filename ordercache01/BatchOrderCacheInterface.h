@@ -0,0 +1,18 @@
+#pragma once
+
+#include "OrderCacheInterface.h"
+
+#include <string_view>
+#include <vector>
+
+// An OrderCacheInterface which also takes orders and cancels in batches,
+// for replaying many orders at once, e.g. at session open.
+class BatchOrderCacheInterface : public OrderCacheInterface
+{
+public:
+    // add all orders to the cache, as if added one by one in this order
+    virtual void addOrders(const std::vector<Order>& orders) = 0;
+
+    // remove the orders with these order ids from the cache
+    virtual void cancelOrders(const std::vector<std::string_view>& orderIds) = 0;
+};
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// Position of the highest bit set. The bits must not be 0.
+inline std::size_t highestSetBit(std::uint64_t bits) noexcept
+{
+#ifdef _MSC_VER
+    unsigned long index = 0;
+    _BitScanReverse64(&index, bits);
+    return index;
+#else
+    return 63 - static_cast<std::size_t>(__builtin_clzll(bits));
+#endif
+}
@@ -0,0 +1,423 @@
+#include "Journal.h"
+#include "MappedFile.h"
+
+#include <cstring>
+#include <filesystem>
+#include <limits>
+#include <stdexcept>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#elif defined(_WIN32)
+#include <io.h>
+#endif
+
+namespace
+{
+    // Byte offsets of the record header fields.
+    constexpr std::size_t size_offset = 0;
+    constexpr std::size_t checksum_offset = 4;
+    constexpr std::size_t sequence_offset = 8;
+    constexpr std::size_t kind_offset = 16;
+    constexpr std::size_t qty_offset = 20;
+    constexpr std::size_t lengths_offset = 24;
+    constexpr std::size_t header_size = 40;
+
+    constexpr std::size_t field_count = 5;
+
+    template <typename T>
+    void put(unsigned char* at, T value)
+    {
+        std::memcpy(at, &value, sizeof(T));
+    }
+
+    template <typename T>
+    T get(const unsigned char* at)
+    {
+        T value;
+        std::memcpy(&value, at, sizeof(T));
+        return value;
+    }
+
+    // FNV-1a, enough to tell a whole record from a torn one.
+    std::uint32_t checksum(const unsigned char* bytes, std::size_t size)
+    {
+        std::uint32_t hash = 2166136261u;
+
+        for(std::size_t i = 0; i < size; ++i)
+        {
+            hash = (hash ^ bytes[i]) * 16777619u;
+        }
+
+        return hash;
+    }
+
+    void syncToDisk(std::FILE* file)
+    {
+#if defined(__linux__)
+        const bool synced = 0 == ::fdatasync(::fileno(file));
+#elif defined(__unix__) || defined(__APPLE__)
+        const bool synced = 0 == ::fsync(::fileno(file));
+#elif defined(_WIN32)
+        const bool synced = 0 == ::_commit(::_fileno(file));
+#else
+        const bool synced = true;
+#endif
+
+        if(!synced)
+        {
+            throw std::runtime_error{ "cannot sync file" };
+        }
+    }
+}
+
+Journal::Journal(const std::string& path, std::uint64_t next_sequence, JournalOptions options) :
+    path{ path },
+    options{ options },
+    last_appended{ next_sequence - 1 },
+    last_committed{ next_sequence - 1 }
+{
+    file = std::fopen(path.c_str(), "ab");
+
+    if(nullptr == file)
+    {
+        throw std::runtime_error{ "cannot open " + path };
+    }
+
+    writer = std::thread{ [this] { writeLoop(); } };
+}
+
+Journal::~Journal()
+{
+    try
+    {
+        close();
+    }
+    catch(const std::exception& error)
+    {
+        std::fprintf(stderr, "%s: records of the last group may be lost\n", error.what());
+    }
+}
+
+std::uint64_t Journal::append(JournalRecord record)
+{
+    const std::string_view fields[field_count] = { record.order_id, record.security_id, record.side, record.user, record.company };
+
+    std::size_t size = header_size;
+
+    for(const std::string_view field : fields)
+    {
+        if(field.size() > std::numeric_limits<std::uint16_t>::max())
+        {
+            throw std::runtime_error{ "journal field too long" };
+        }
+
+        size += field.size();
+    }
+
+    std::unique_lock<std::mutex> lock{ mutex };
+
+    if(stopping)
+    {
+        throw std::runtime_error{ "journal " + path + " is closed" };
+    }
+
+    record.sequence = ++last_appended;
+
+    const std::size_t start = pending.size();
+    pending.resize(start + size);
+
+    unsigned char* bytes = pending.data() + start;
+
+    std::memset(bytes, 0, header_size);
+    put(bytes + size_offset, static_cast<std::uint32_t>(size));
+    put(bytes + sequence_offset, record.sequence);
+    put(bytes + kind_offset, static_cast<std::uint8_t>(record.kind));
+    put(bytes + qty_offset, static_cast<std::uint32_t>(record.qty));
+
+    unsigned char* out = bytes + header_size;
+
+    for(std::size_t i = 0; i < field_count; ++i)
+    {
+        put(bytes + lengths_offset + i * sizeof(std::uint16_t), static_cast<std::uint16_t>(fields[i].size()));
+
+        if(!fields[i].empty())
+        {
+            std::memcpy(out, fields[i].data(), fields[i].size());
+            out += fields[i].size();
+        }
+    }
+
+    put(bytes + checksum_offset, checksum(bytes + sequence_offset, size - sequence_offset));
+
+    // Wake the writer for the first record of a group, to start its interval, and when the group is full.
+    const bool wake = 1 == ++pending_records || pending_records == options.group_records;
+
+    lock.unlock();
+
+    if(wake)
+    {
+        work_ready.notify_one();
+    }
+
+    return record.sequence;
+}
+
+void Journal::flush()
+{
+    std::unique_lock<std::mutex> lock{ mutex };
+
+    flush_target = last_appended;
+    work_ready.notify_one();
+
+    committed.wait(lock, [this] { return last_committed >= flush_target; });
+
+    if(failed)
+    {
+        throw std::runtime_error{ "cannot write " + path };
+    }
+}
+
+void Journal::truncate()
+{
+    flush();
+
+    std::lock_guard<std::mutex> lock{ mutex };
+
+    if(nullptr == file)
+    {
+        throw std::runtime_error{ "journal " + path + " is closed" };
+    }
+
+    std::fflush(file);
+    std::filesystem::resize_file(path, 0);
+
+    if(options.sync)
+    {
+        syncToDisk(file);
+    }
+}
+
+void Journal::close()
+{
+    if(nullptr == file)
+    {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock{ mutex };
+        stopping = true;
+    }
+
+    work_ready.notify_one();
+    writer.join();
+
+    const bool closed = 0 == std::fclose(file);
+    file = nullptr;
+
+    if(failed || !closed)
+    {
+        throw std::runtime_error{ "cannot write " + path };
+    }
+}
+
+std::uint64_t Journal::lastSequence() const
+{
+    std::lock_guard<std::mutex> lock{ mutex };
+
+    return last_appended;
+}
+
+void Journal::writeLoop()
+{
+    std::vector<unsigned char> writing;
+
+    std::unique_lock<std::mutex> lock{ mutex };
+
+    for(;;)
+    {
+        work_ready.wait(lock, [this] { return stopping || pending_records > 0; });
+
+        // Give the group until its interval ends to fill up, unless someone waits on it.
+        work_ready.wait_for(lock, options.group_interval, [this]
+        {
+            return stopping || pending_records >= options.group_records || flush_target > last_committed;
+        });
+
+        if(0 == pending_records)
+        {
+            if(stopping)
+            {
+                return;
+            }
+
+            continue;
+        }
+
+        writing.swap(pending);
+        pending_records = 0;
+
+        const std::uint64_t sequence = last_appended;
+
+        lock.unlock();
+
+        bool written = true;
+
+        try
+        {
+            commit(writing);
+        }
+        catch(const std::exception&)
+        {
+            written = false;
+        }
+
+        writing.clear();
+
+        lock.lock();
+
+        failed = failed || !written;
+        last_committed = sequence;
+
+        committed.notify_all();
+    }
+}
+
+void Journal::commit(const std::vector<unsigned char>& bytes)
+{
+    if(std::fwrite(bytes.data(), 1, bytes.size(), file) != bytes.size() || std::fflush(file) != 0)
+    {
+        throw std::runtime_error{ "cannot write " + path };
+    }
+
+    if(options.sync)
+    {
+        syncToDisk(file);
+    }
+}
+
+void Journal::syncFile(const std::string& path)
+{
+    std::FILE* file = std::fopen(path.c_str(), "rb+");
+
+    if(nullptr == file)
+    {
+        throw std::runtime_error{ "cannot open " + path };
+    }
+
+    try
+    {
+        syncToDisk(file);
+    }
+    catch(const std::exception&)
+    {
+        std::fclose(file);
+        throw;
+    }
+
+    std::fclose(file);
+}
+
+void Journal::syncDirectory(const std::string& path)
+{
+#if defined(__unix__) || defined(__APPLE__)
+    std::filesystem::path directory = std::filesystem::path{ path }.parent_path();
+
+    if(directory.empty())
+    {
+        directory = ".";
+    }
+
+    const int fd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY);
+
+    if(fd < 0)
+    {
+        throw std::runtime_error{ "cannot open " + directory.string() };
+    }
+
+    const bool synced = 0 == ::fsync(fd);
+
+    ::close(fd);
+
+    if(!synced)
+    {
+        throw std::runtime_error{ "cannot sync " + directory.string() };
+    }
+#else
+    (void)path;
+#endif
+}
+
+std::uint64_t Journal::replay(const std::string& path, std::uint64_t after_sequence,
+    const std::function<void(const JournalRecord&)>& apply)
+{
+    if(!std::filesystem::exists(path))
+    {
+        return 0;
+    }
+
+    std::uint64_t last_sequence = 0;
+    std::size_t valid_size = 0;
+    std::size_t file_size = 0;
+
+    {
+        const MappedFile file{ path };
+
+        const unsigned char* bytes = file.data();
+        file_size = file.size();
+
+        while(file_size - valid_size >= header_size)
+        {
+            const unsigned char* at = bytes + valid_size;
+            const std::size_t size = get<std::uint32_t>(at + size_offset);
+
+            if(size < header_size || size > file_size - valid_size
+                || get<std::uint32_t>(at + checksum_offset) != checksum(at + sequence_offset, size - sequence_offset))
+            {
+                break;
+            }
+
+            JournalRecord record;
+
+            record.kind = static_cast<JournalRecord::Kind>(get<std::uint8_t>(at + kind_offset));
+            record.sequence = get<std::uint64_t>(at + sequence_offset);
+            record.qty = get<std::uint32_t>(at + qty_offset);
+
+            std::string_view* fields[field_count] = { &record.order_id, &record.security_id, &record.side, &record.user, &record.company };
+
+            const char* field = reinterpret_cast<const char*>(at + header_size);
+            std::size_t fields_size = 0;
+
+            for(std::size_t i = 0; i < field_count; ++i)
+            {
+                const std::size_t length = get<std::uint16_t>(at + lengths_offset + i * sizeof(std::uint16_t));
+
+                *fields[i] = { field, length };
+                field += length;
+                fields_size += length;
+            }
+
+            if(header_size + fields_size != size)
+            {
+                break;
+            }
+
+            if(record.sequence > after_sequence)
+            {
+                apply(record);
+            }
+
+            last_sequence = record.sequence;
+            valid_size += size;
+        }
+    }
+
+    if(valid_size != file_size)
+    {
+        std::filesystem::resize_file(path, valid_size);
+    }
+
+    return last_sequence;
+}
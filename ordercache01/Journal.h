@@ -0,0 +1,145 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdio>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// One mutation of an order cache, as written to a journal.
+// The string fields view memory of the caller; unused fields are empty.
+struct JournalRecord
+{
+    enum class Kind : std::uint8_t
+    {
+        AddOrder = 1,
+        CancelOrder = 2,
+        CancelOrdersForUser = 3,
+        CancelOrdersForSecIdWithMinimumQty = 4,
+        CancelOrdersForCompany = 5,
+        AmendQty = 6,
+        ReduceQty = 7,
+    };
+
+    Kind kind = Kind::AddOrder;
+
+    // Position of the record in the journal, starting at 1.
+    std::uint64_t sequence = 0;
+
+    // qty of AddOrder and AmendQty, minQty of CancelOrdersForSecIdWithMinimumQty, delta of ReduceQty
+    unsigned int qty = 0;
+
+    std::string_view order_id;
+    std::string_view security_id;
+    std::string_view side;
+    std::string_view user;
+    std::string_view company;
+};
+
+// When the journal writer commits a group of records to disk.
+struct JournalOptions
+{
+    // commit as soon as this many records are waiting
+    std::size_t group_records = 256;
+
+    // commit records that have waited this long, even when fewer than group_records
+    std::chrono::microseconds group_interval{ 500 };
+
+    // make each group durable with fdatasync; off leaves that to the operating system
+    bool sync = true;
+};
+
+// An append-only log of JournalRecords with group commit.
+// append only copies the record to a buffer; a background thread writes the buffered
+// records to the file and syncs it, group_records at a time or every group_interval.
+//
+// Each record has a fixed layout: a 40-byte header with its size, checksum, sequence,
+// kind, qty and field lengths, followed by the field bytes. A torn record at the end of
+// the file, left by a crash, fails its size or checksum and ends the replay.
+class Journal
+{
+public:
+    // open the journal for appending, creating the file if needed
+    // Records appended get sequences after next_sequence - 1.
+    // Throw std::runtime_error if the file cannot be opened.
+    Journal(const std::string& path, std::uint64_t next_sequence, JournalOptions options = {});
+
+    // commit every appended record, stop the writer and close the file, if not closed yet
+    // A failed commit cannot be thrown from here, so it is reported on stderr; call close
+    // first to handle it.
+    ~Journal();
+
+    Journal(const Journal&) = delete;
+    Journal& operator = (const Journal&) = delete;
+
+    // buffer the record for the writer and return its sequence
+    // Throw std::runtime_error if the journal is closed.
+    std::uint64_t append(JournalRecord record);
+
+    // wait until every record appended so far is committed
+    // Throw std::runtime_error if the writer failed to write the file.
+    void flush();
+
+    // commit every appended record, then empty the file, synced if the options say so
+    // Sequences keep counting from where they were.
+    // Throw std::runtime_error if the journal is closed.
+    void truncate();
+
+    // commit every appended record, stop the writer and close the file
+    // Does nothing if already closed.
+    // Throw std::runtime_error if the writer failed to write the file.
+    void close();
+
+    // return the sequence of the last appended record, 0 if none
+    std::uint64_t lastSequence() const;
+
+    // write the file at path through to the disk
+    // Throw std::runtime_error if it cannot be opened or synced.
+    static void syncFile(const std::string& path);
+
+    // write the entries of the directory holding path through to the disk, so that a file
+    // created or renamed to path stays there after a crash; does nothing where directories
+    // cannot be synced
+    // Throw std::runtime_error if it cannot be opened or synced.
+    static void syncDirectory(const std::string& path);
+
+    // call apply for each record of the journal file with a sequence after after_sequence
+    // Stop at the end of the file or at the first torn record, and cut the file there, so
+    // appending continues after the last whole record.
+    // Return the sequence of the last whole record, 0 if none.
+    static std::uint64_t replay(const std::string& path, std::uint64_t after_sequence,
+        const std::function<void(const JournalRecord&)>& apply);
+
+private:
+    void writeLoop();
+
+    // write bytes at the end of the file and sync it if the options say so
+    void commit(const std::vector<unsigned char>& bytes);
+
+    const std::string path;
+    const JournalOptions options;
+
+    std::FILE* file = nullptr;
+
+    mutable std::mutex mutex;
+    std::condition_variable work_ready;
+    std::condition_variable committed;
+
+    // Records appended since the writer last took them.
+    std::vector<unsigned char> pending;
+    std::size_t pending_records = 0;
+
+    std::uint64_t last_appended = 0;
+    std::uint64_t last_committed = 0;
+    std::uint64_t flush_target = 0;
+    bool stopping = false;
+    bool failed = false;
+
+    std::thread writer;
+};
@@ -0,0 +1,232 @@
+#include "JournaledOrderCache.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <stdexcept>
+
+JournaledOrderCache::JournaledOrderCache(const std::string& snapshot_path, const std::string& journal_path, JournalOptions options) :
+    snapshot_path{ snapshot_path },
+    journal{ journal_path, recover(orders, snapshot_path, journal_path) + 1, options }
+{
+}
+
+void JournaledOrderCache::addOrder(Order order)
+{
+    journalAdd(order);
+
+    orders.addOrder(std::move(order));
+}
+
+void JournaledOrderCache::journalAdd(const Order& order)
+{
+    const std::string order_id = order.orderId();
+    const std::string security_id = order.securityId();
+    const std::string side = order.side();
+    const std::string user = order.user();
+    const std::string company = order.company();
+
+    JournalRecord record;
+
+    record.kind = JournalRecord::Kind::AddOrder;
+    record.qty = order.qty();
+    record.order_id = order_id;
+    record.security_id = security_id;
+    record.side = side;
+    record.user = user;
+    record.company = company;
+
+    journal.append(record);
+}
+
+void JournaledOrderCache::cancelOrder(const std::string& orderId)
+{
+    JournalRecord record;
+
+    record.kind = JournalRecord::Kind::CancelOrder;
+    record.order_id = orderId;
+
+    journal.append(record);
+
+    orders.cancelOrder(orderId);
+}
+
+void JournaledOrderCache::cancelOrdersForUser(const std::string& user)
+{
+    JournalRecord record;
+
+    record.kind = JournalRecord::Kind::CancelOrdersForUser;
+    record.user = user;
+
+    journal.append(record);
+
+    orders.cancelOrdersForUser(user);
+}
+
+void JournaledOrderCache::cancelOrdersForSecIdWithMinimumQty(const std::string& securityId, unsigned int minQty)
+{
+    JournalRecord record;
+
+    record.kind = JournalRecord::Kind::CancelOrdersForSecIdWithMinimumQty;
+    record.qty = minQty;
+    record.security_id = securityId;
+
+    journal.append(record);
+
+    orders.cancelOrdersForSecIdWithMinimumQty(securityId, minQty);
+}
+
+unsigned int JournaledOrderCache::getMatchingSizeForSecurity(const std::string& securityId)
+{
+    return orders.getMatchingSizeForSecurity(securityId);
+}
+
+std::vector<Order> JournaledOrderCache::getAllOrders() const
+{
+    return orders.getAllOrders();
+}
+
+void JournaledOrderCache::addOrders(const std::vector<Order>& batch)
+{
+    for(const Order& order : batch)
+    {
+        journalAdd(order);
+    }
+
+    orders.addOrders(batch);
+}
+
+void JournaledOrderCache::cancelOrders(const std::vector<std::string_view>& orderIds)
+{
+    JournalRecord record;
+
+    record.kind = JournalRecord::Kind::CancelOrder;
+
+    for(const std::string_view orderId : orderIds)
+    {
+        record.order_id = orderId;
+        journal.append(record);
+    }
+
+    orders.cancelOrders(orderIds);
+}
+
+void JournaledOrderCache::cancelOrdersForCompany(const std::string& company)
+{
+    JournalRecord record;
+
+    record.kind = JournalRecord::Kind::CancelOrdersForCompany;
+    record.company = company;
+
+    journal.append(record);
+
+    orders.cancelOrdersForCompany(company);
+}
+
+void JournaledOrderCache::amendQty(const std::string& orderId, unsigned int qty)
+{
+    JournalRecord record;
+
+    record.kind = JournalRecord::Kind::AmendQty;
+    record.qty = qty;
+    record.order_id = orderId;
+
+    journal.append(record);
+
+    orders.amendQty(orderId, qty);
+}
+
+void JournaledOrderCache::reduceQty(const std::string& orderId, unsigned int delta)
+{
+    JournalRecord record;
+
+    record.kind = JournalRecord::Kind::ReduceQty;
+    record.qty = delta;
+    record.order_id = orderId;
+
+    journal.append(record);
+
+    orders.reduceQty(orderId, delta);
+}
+
+void JournaledOrderCache::flush()
+{
+    journal.flush();
+}
+
+void JournaledOrderCache::checkpoint()
+{
+    journal.flush();
+
+    // Write aside and rename, so a crash leaves either the old snapshot or the new one.
+    const std::string temporary_path = snapshot_path + ".tmp";
+
+    orders.saveSnapshot(temporary_path, journal.lastSequence());
+    Journal::syncFile(temporary_path);
+    std::filesystem::rename(temporary_path, snapshot_path);
+
+    // The rename must reach the disk before the truncation may: after a crash, the old snapshot
+    // with an empty journal would lose every record since that snapshot.
+    Journal::syncDirectory(snapshot_path);
+
+    // Replay skips the records the snapshot holds, so a crash before this only costs recovery time.
+    journal.truncate();
+}
+
+void JournaledOrderCache::close()
+{
+    journal.close();
+}
+
+std::uint64_t JournaledOrderCache::recover(OrderCache& orders, const std::string& snapshot_path, const std::string& journal_path)
+{
+    std::uint64_t snapshot_sequence = 0;
+
+    if(std::filesystem::exists(snapshot_path))
+    {
+        snapshot_sequence = orders.loadSnapshot(snapshot_path);
+    }
+
+    const std::uint64_t journal_sequence = Journal::replay(journal_path, snapshot_sequence,
+        [&orders](const JournalRecord& record) { apply(orders, record); });
+
+    return std::max(snapshot_sequence, journal_sequence);
+}
+
+void JournaledOrderCache::apply(OrderCache& orders, const JournalRecord& record)
+{
+    switch(record.kind)
+    {
+    case JournalRecord::Kind::AddOrder:
+        orders.addOrder({ std::string{ record.order_id }, std::string{ record.security_id }, std::string{ record.side },
+            record.qty, std::string{ record.user }, std::string{ record.company } });
+        break;
+
+    case JournalRecord::Kind::CancelOrder:
+        orders.cancelOrder(std::string{ record.order_id });
+        break;
+
+    case JournalRecord::Kind::CancelOrdersForUser:
+        orders.cancelOrdersForUser(std::string{ record.user });
+        break;
+
+    case JournalRecord::Kind::CancelOrdersForSecIdWithMinimumQty:
+        orders.cancelOrdersForSecIdWithMinimumQty(std::string{ record.security_id }, record.qty);
+        break;
+
+    case JournalRecord::Kind::CancelOrdersForCompany:
+        orders.cancelOrdersForCompany(std::string{ record.company });
+        break;
+
+    case JournalRecord::Kind::AmendQty:
+        orders.amendQty(std::string{ record.order_id }, record.qty);
+        break;
+
+    case JournalRecord::Kind::ReduceQty:
+        orders.reduceQty(std::string{ record.order_id }, record.qty);
+        break;
+
+    default:
+        throw std::runtime_error{ "unknown journal record kind " + std::to_string(static_cast<int>(record.kind)) };
+    }
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include "BatchOrderCacheInterface.h"
+#include "Journal.h"
+#include "OrderCache.h"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// An OrderCache that writes every mutation to a journal before applying it, so its
+// state can be recovered after a restart: load the last snapshot, then replay the
+// journal records that came after it.
+//
+// Mutations are durable once the journal writer commits their group; flush waits for that.
+// checkpoint writes a snapshot and empties the journal, to bound recovery time.
+class JournaledOrderCache : public BatchOrderCacheInterface
+{
+public:
+    // recover the cache from the snapshot file and the journal file, either of which may
+    // not exist yet, then journal every mutation to the journal file
+    // Throw std::runtime_error if the snapshot is not valid or a file cannot be opened.
+    JournaledOrderCache(const std::string& snapshot_path, const std::string& journal_path, JournalOptions options = {});
+
+    // add order to the cache
+    void addOrder(Order order) override;
+
+    // remove order with this unique order id from the cache
+    void cancelOrder(const std::string& orderId) override;
+
+    // remove all orders in the cache for this user
+    void cancelOrdersForUser(const std::string& user) override;
+
+    // remove all orders in the cache for this security with qty >= minQty
+    void cancelOrdersForSecIdWithMinimumQty(const std::string& securityId, unsigned int minQty) override;
+
+    // return the total qty that can match for the security id
+    unsigned int getMatchingSizeForSecurity(const std::string& securityId) override;
+
+    // return all orders in cache in a vector
+    std::vector<Order> getAllOrders() const override;
+
+    // add all orders to the cache, as if added one by one in this order
+    // Journaled as one AddOrder record per order.
+    void addOrders(const std::vector<Order>& orders) override;
+
+    // remove the orders with these order ids from the cache
+    // Journaled as one CancelOrder record per order id.
+    void cancelOrders(const std::vector<std::string_view>& orderIds) override;
+
+    // remove all orders in the cache for this company
+    void cancelOrdersForCompany(const std::string& company);
+
+    // set the qty of the order with this order id, removing the order if qty is 0
+    void amendQty(const std::string& orderId, unsigned int qty);
+
+    // reduce the qty of the order with this order id by delta, removing the order once no qty is left
+    void reduceQty(const std::string& orderId, unsigned int delta);
+
+    // wait until every mutation so far is durable in the journal
+    void flush();
+
+    // write a snapshot of the cache, then empty the journal
+    void checkpoint();
+
+    // make every mutation durable and close the journal; the cache takes no more mutations
+    // Throw std::runtime_error if the journal writer failed to write the file.
+    void close();
+
+    // return the cache the journal applies to
+    const OrderCache& cache() const noexcept { return orders; }
+
+private:
+    // load the snapshot, replay the journal records after it and return the last sequence applied
+    static std::uint64_t recover(OrderCache& orders, const std::string& snapshot_path, const std::string& journal_path);
+
+    // apply a journal record to the cache
+    static void apply(OrderCache& orders, const JournalRecord& record);
+
+    // append the AddOrder record of the order to the journal
+    void journalAdd(const Order& order);
+
+    const std::string snapshot_path;
+
+    OrderCache orders;
+
+    // Constructed after orders are recovered, to continue their sequence.
+    Journal journal;
+};
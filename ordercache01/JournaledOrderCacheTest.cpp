@@ -0,0 +1,198 @@
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "JournaledOrderCache.h"
+#include "OrderCacheTestHelpers.h"
+
+namespace
+{
+    // Journal and snapshot paths of a test, removed before and after it.
+    struct JournalFiles
+    {
+        explicit JournalFiles(const std::string& name) :
+            snapshot{ (std::filesystem::temp_directory_path() / (name + ".snap")).string() },
+            journal{ (std::filesystem::temp_directory_path() / (name + ".journal")).string() }
+        {
+            remove();
+        }
+
+        ~JournalFiles() { remove(); }
+
+        void remove() const
+        {
+            std::filesystem::remove(snapshot);
+            std::filesystem::remove(journal);
+        }
+
+        const std::string snapshot;
+        const std::string journal;
+    };
+
+    template <typename Cache>
+    void mutate(Cache& cache, int first, int count)
+    {
+        for(int i = first; i < first + count; ++i)
+        {
+            cache.addOrder({ "o" + std::to_string(i), "s" + std::to_string(i % 7), i % 3 ? "Buy" : "Sell",
+                static_cast<unsigned int>(100 + i % 500), "u" + std::to_string(i % 5), "c" + std::to_string(i % 4) });
+
+            if(0 == i % 10)
+            {
+                cache.cancelOrder("o" + std::to_string(i - 5));
+            }
+        }
+
+        cache.cancelOrdersForUser("u" + std::to_string(first % 5));
+        cache.cancelOrdersForSecIdWithMinimumQty("s" + std::to_string(first % 7), 400);
+    }
+}
+
+TEST(JournaledOrderCacheTest, RecoversFromJournal)
+{
+    const JournalFiles files{ "JournaledOrderCacheTest.RecoversFromJournal" };
+
+    OrderCache expected;
+    mutate(expected, 0, 1000);
+
+    {
+        JournaledOrderCache cache{ files.snapshot, files.journal };
+        mutate(cache, 0, 1000);
+
+        EXPECT_EQ(sortedFields(cache.getAllOrders()), sortedFields(expected.getAllOrders()));
+    }
+
+    JournaledOrderCache recovered{ files.snapshot, files.journal };
+
+    EXPECT_EQ(sortedFields(recovered.getAllOrders()), sortedFields(expected.getAllOrders()));
+
+    for(int s = 0; s < 7; ++s)
+    {
+        const std::string security = "s" + std::to_string(s);
+        EXPECT_EQ(recovered.getMatchingSizeForSecurity(security), expected.getMatchingSizeForSecurity(security)) << security;
+    }
+}
+
+TEST(JournaledOrderCacheTest, RecoversFromCheckpointAndJournal)
+{
+    const JournalFiles files{ "JournaledOrderCacheTest.RecoversFromCheckpointAndJournal" };
+
+    JournalOptions options;
+    options.group_records = 16;
+    options.sync = false;
+
+    OrderCache expected;
+    mutate(expected, 0, 500);
+    mutate(expected, 500, 500);
+    mutate(expected, 250, 500);
+
+    {
+        JournaledOrderCache cache{ files.snapshot, files.journal, options };
+        mutate(cache, 0, 500);
+        cache.checkpoint();
+
+        EXPECT_EQ(std::filesystem::file_size(files.journal), 0u);
+
+        mutate(cache, 500, 500);
+    }
+
+    {
+        JournaledOrderCache cache{ files.snapshot, files.journal, options };
+        mutate(cache, 250, 500);
+        cache.flush();
+
+        EXPECT_EQ(sortedFields(cache.getAllOrders()), sortedFields(expected.getAllOrders()));
+    }
+
+    JournaledOrderCache recovered{ files.snapshot, files.journal, options };
+
+    EXPECT_EQ(sortedFields(recovered.getAllOrders()), sortedFields(expected.getAllOrders()));
+}
+
+TEST(JournaledOrderCacheTest, StopsReplayAtTornRecord)
+{
+    const JournalFiles files{ "JournaledOrderCacheTest.StopsReplayAtTornRecord" };
+
+    {
+        JournaledOrderCache cache{ files.snapshot, files.journal };
+        cache.addOrder({ "o1", "s1", "Buy", 100, "u1", "c1" });
+        cache.addOrder({ "o2", "s1", "Sell", 200, "u2", "c2" });
+    }
+
+    // A crash in the middle of writing the last record.
+    std::filesystem::resize_file(files.journal, std::filesystem::file_size(files.journal) - 3);
+
+    {
+        JournaledOrderCache recovered{ files.snapshot, files.journal };
+
+        EXPECT_EQ(sortedFields(recovered.getAllOrders()), sortedFields({ { "o1", "s1", "Buy", 100, "u1", "c1" } }));
+
+        // Appending goes on after the last whole record.
+        recovered.addOrder({ "o3", "s1", "Sell", 300, "u3", "c3" });
+    }
+
+    JournaledOrderCache recovered{ files.snapshot, files.journal };
+
+    EXPECT_EQ(sortedFields(recovered.getAllOrders()),
+        sortedFields({ { "o1", "s1", "Buy", 100, "u1", "c1" }, { "o3", "s1", "Sell", 300, "u3", "c3" } }));
+}
+
+TEST(JournaledOrderCacheTest, RecoversBatchesAmendsAndCompanyCancels)
+{
+    const JournalFiles files{ "JournaledOrderCacheTest.RecoversBatchesAmendsAndCompanyCancels" };
+
+    std::vector<Order> batch;
+
+    for(int i = 0; i < 200; ++i)
+    {
+        batch.push_back({ "b" + std::to_string(i), "s" + std::to_string(i % 7), i % 2 ? "Buy" : "Sell",
+            static_cast<unsigned int>(100 + i), "u" + std::to_string(i % 5), "c" + std::to_string(i % 4) });
+    }
+
+    const std::vector<std::string_view> cancelled = { "b3", "b17", "b18", "o40", "missing" };
+
+    const auto mutateAll = [&](auto& cache)
+    {
+        mutate(cache, 0, 100);
+        cache.addOrders(batch);
+        cache.cancelOrders(cancelled);
+        cache.amendQty("b5", 700);
+        cache.amendQty("b6", 0);
+        cache.reduceQty("b7", 50);
+        cache.reduceQty("b8", 1000);
+        cache.cancelOrdersForCompany("c1");
+    };
+
+    OrderCache expected;
+    mutateAll(expected);
+
+    {
+        JournaledOrderCache cache{ files.snapshot, files.journal };
+        mutateAll(cache);
+        cache.close();
+
+        EXPECT_THROW(cache.addOrder({ "o1", "s1", "Buy", 100, "u1", "c1" }), std::runtime_error);
+    }
+
+    JournaledOrderCache recovered{ files.snapshot, files.journal };
+
+    EXPECT_EQ(sortedFields(recovered.getAllOrders()), sortedFields(expected.getAllOrders()));
+}
+
+#if defined(__linux__)
+TEST(JournaledOrderCacheTest, ReportsFailedFinalCommitOnClose)
+{
+    JournalOptions options;
+    options.sync = false;
+
+    // Every write to /dev/full fails for lack of space.
+    Journal journal{ "/dev/full", 1, options };
+    journal.append({});
+
+    EXPECT_THROW(journal.close(), std::runtime_error);
+}
+#endif
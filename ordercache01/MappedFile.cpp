@@ -0,0 +1,84 @@
+#include "MappedFile.h"
+
+#include <stdexcept>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define ORDERCACHE_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#include <fstream>
+#include <iterator>
+#endif
+
+#ifdef ORDERCACHE_MMAP
+
+MappedFile::MappedFile(const std::string& path)
+{
+    const int fd = ::open(path.c_str(), O_RDONLY);
+
+    if(fd < 0)
+    {
+        throw std::runtime_error{ "cannot open " + path };
+    }
+
+    struct stat status{};
+
+    if(::fstat(fd, &status) != 0)
+    {
+        ::close(fd);
+        throw std::runtime_error{ "cannot stat " + path };
+    }
+
+    length = static_cast<std::size_t>(status.st_size);
+
+    if(length > 0)
+    {
+        void* mapped = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+
+        if(mapped == MAP_FAILED)
+        {
+            ::close(fd);
+            throw std::runtime_error{ "cannot map " + path };
+        }
+
+        // The whole file is read front to back right away. Advice values are not flags, so one call each.
+        ::madvise(mapped, length, MADV_SEQUENTIAL);
+        ::madvise(mapped, length, MADV_WILLNEED);
+
+        bytes = static_cast<const unsigned char*>(mapped);
+    }
+
+    ::close(fd);
+}
+
+MappedFile::~MappedFile()
+{
+    if(bytes)
+    {
+        ::munmap(const_cast<unsigned char*>(bytes), length);
+    }
+}
+
+#else
+
+MappedFile::MappedFile(const std::string& path)
+{
+    std::ifstream file{ path, std::ios::binary };
+
+    if(!file)
+    {
+        throw std::runtime_error{ "cannot open " + path };
+    }
+
+    buffer.assign(std::istreambuf_iterator<char>{ file }, std::istreambuf_iterator<char>{});
+
+    bytes = buffer.data();
+    length = buffer.size();
+}
+
+MappedFile::~MappedFile() = default;
+
+#endif
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// A whole file mapped read-only into memory.
+// Uses mmap where available and reads the file into a buffer elsewhere.
+class MappedFile
+{
+public:
+    // map the file, throw std::runtime_error if it cannot be opened
+    explicit MappedFile(const std::string& path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator = (const MappedFile&) = delete;
+
+    const unsigned char* data() const noexcept { return bytes; }
+    std::size_t size() const noexcept { return length; }
+
+private:
+    const unsigned char* bytes = nullptr;
+    std::size_t length = 0;
+
+    // Holds the file when it is not mapped.
+    std::vector<unsigned char> buffer;
+};
@@ -0,0 +1,71 @@
+#include "MatchingSizeBoard.h"
+
+#include <functional>
+
+MatchingSizeBoard::MatchingSizeBoard()
+{
+    tables.push_back(std::make_unique<Table>(64));
+    table.store(tables.back().get(), std::memory_order_release);
+}
+
+void MatchingSizeBoard::publish(const std::string& securityId, unsigned int matching_size)
+{
+    if(Entry* entry = find(*table.load(std::memory_order_acquire), securityId))
+    {
+        entry->matching_size.store(matching_size, std::memory_order_release);
+        return;
+    }
+
+    std::lock_guard lock{ insert_mutex };
+
+    const Table* current = table.load(std::memory_order_relaxed);
+
+    // Grow before the table gets more than half full.
+    if((entries.size() + 1) * 2 > current->mask + 1)
+    {
+        tables.push_back(std::make_unique<Table>((current->mask + 1) * 2));
+
+        for(const auto& entry : entries)
+        {
+            insert(*tables.back(), entry.get());
+        }
+
+        current = tables.back().get();
+        table.store(current, std::memory_order_release);
+    }
+
+    entries.push_back(std::make_unique<Entry>(securityId, matching_size));
+    insert(*current, entries.back().get());
+}
+
+unsigned int MatchingSizeBoard::read(const std::string& securityId) const noexcept
+{
+    const Entry* entry = find(*table.load(std::memory_order_acquire), securityId);
+
+    return entry ? entry->matching_size.load(std::memory_order_acquire) : 0;
+}
+
+MatchingSizeBoard::Entry* MatchingSizeBoard::find(const Table& table, const std::string& securityId) noexcept
+{
+    for(std::size_t pos = std::hash<std::string>{}(securityId) & table.mask; ; pos = (pos + 1) & table.mask)
+    {
+        Entry* entry = table.slots[pos].load(std::memory_order_acquire);
+
+        if(!entry || entry->security_id == securityId)
+        {
+            return entry;
+        }
+    }
+}
+
+void MatchingSizeBoard::insert(const Table& table, Entry* entry) noexcept
+{
+    std::size_t pos = std::hash<std::string>{}(entry->security_id) & table.mask;
+
+    while(table.slots[pos].load(std::memory_order_relaxed))
+    {
+        pos = (pos + 1) & table.mask;
+    }
+
+    table.slots[pos].store(entry, std::memory_order_release);
+}
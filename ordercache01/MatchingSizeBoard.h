@@ -0,0 +1,71 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Matching sizes published per security for readers which must never block or be blocked.
+// Writers publish the matching size of a security after changing it; readers find the last
+// published value in a bounded number of steps without taking any lock.
+// Securities are never removed. Tables replaced by a larger one are kept until the board is
+// destroyed, so a reader still probing an old table stays safe.
+class MatchingSizeBoard
+{
+public:
+    MatchingSizeBoard();
+
+    MatchingSizeBoard(const MatchingSizeBoard&) = delete;
+    MatchingSizeBoard& operator = (const MatchingSizeBoard&) = delete;
+
+    // publish the matching size of the security
+    // Calls for the same security must not run concurrently.
+    void publish(const std::string& securityId, unsigned int matching_size);
+
+    // return the last matching size published for the security or 0 if none was published
+    unsigned int read(const std::string& securityId) const noexcept;
+
+private:
+    struct Entry
+    {
+        Entry(const std::string& securityId, unsigned int matching_size) :
+            security_id{ securityId },
+            matching_size{ matching_size }
+        {
+        }
+
+        const std::string security_id;
+        std::atomic<unsigned int> matching_size;
+    };
+
+    // Open addressing with linear probing, kept at most half full so every probe ends.
+    struct Table
+    {
+        explicit Table(std::size_t capacity) :
+            mask{ capacity - 1 },
+            slots{ new std::atomic<Entry*>[capacity] }
+        {
+            for(std::size_t i = 0; i < capacity; ++i)
+            {
+                slots[i].store(nullptr, std::memory_order_relaxed);
+            }
+        }
+
+        const std::size_t mask;
+        std::unique_ptr<std::atomic<Entry*>[]> slots;
+    };
+
+    std::atomic<const Table*> table;
+
+    // Guards adding securities and replacing the table.
+    std::mutex insert_mutex;
+
+    std::vector<std::unique_ptr<Table>> tables;
+    std::vector<std::unique_ptr<Entry>> entries;
+
+private:
+    static Entry* find(const Table& table, const std::string& securityId) noexcept;
+    static void insert(const Table& table, Entry* entry) noexcept;
+};
@@ -0,0 +1,59 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "MatchingSizeBoard.h"
+
+TEST(MatchingSizeBoardTest, ReadsLastPublishedMatchingSize)
+{
+    MatchingSizeBoard board;
+
+    EXPECT_EQ(board.read("s1"), 0u);
+
+    board.publish("s1", 100);
+    board.publish("s2", 200);
+    board.publish("s1", 300);
+
+    EXPECT_EQ(board.read("s1"), 300u);
+    EXPECT_EQ(board.read("s2"), 200u);
+    EXPECT_EQ(board.read("s3"), 0u);
+}
+
+TEST(MatchingSizeBoardTest, ReadsWhileTableGrows)
+{
+    MatchingSizeBoard board;
+
+    board.publish("fixed", 42);
+
+    std::atomic<bool> done{ false };
+    std::atomic<bool> wrong_read{ false };
+
+    std::thread reader{ [&]
+    {
+        while(!done)
+        {
+            if(board.read("fixed") != 42)
+            {
+                wrong_read = true;
+            }
+        }
+    } };
+
+    for(unsigned int i = 0; i < 10000; ++i)
+    {
+        board.publish("s" + std::to_string(i), i);
+    }
+
+    done = true;
+    reader.join();
+
+    EXPECT_FALSE(wrong_read);
+
+    for(unsigned int i = 0; i < 10000; ++i)
+    {
+        EXPECT_EQ(board.read("s" + std::to_string(i)), i);
+    }
+}
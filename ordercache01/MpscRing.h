@@ -0,0 +1,138 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+// A bounded queue for many producer threads and a single consumer thread, without locks.
+// Every cell carries a sequence number telling whether it is free for the producer of its
+// lap or holds a value for the consumer. Producers claim a cell by moving the tail with a
+// compare-and-swap, then publish the value by advancing the sequence of the cell.
+// A producer stalled between the two steps holds back the consumer until it publishes.
+template <typename T>
+class MpscRing
+{
+public:
+    // capacity is rounded up to a power of two, at least 2
+    explicit MpscRing(std::size_t capacity);
+
+    MpscRing(const MpscRing&) = delete;
+    MpscRing& operator = (const MpscRing&) = delete;
+
+    // move the value into the queue and return true, or return false and leave the value
+    // as it is if the queue is full; any thread
+    bool tryPush(T&& value);
+
+    // move the oldest value out of the queue and return true, or return false if there is
+    // none yet; the consumer thread only
+    bool tryPop(T& value);
+
+    // return true if the next value is not published yet; the consumer thread only
+    bool empty() const noexcept;
+
+    std::size_t capacity() const noexcept { return mask + 1; }
+
+private:
+    // A cell per cache line, so producers of neighbouring cells do not share one.
+    struct alignas(64) Cell
+    {
+        std::atomic<std::size_t> sequence{ 0 };
+        T value{};
+    };
+
+    static std::size_t roundUp(std::size_t capacity) noexcept;
+
+    const std::size_t mask;
+    const std::unique_ptr<Cell[]> cells;
+
+    alignas(64) std::atomic<std::size_t> tail{ 0 };
+
+    // Only touched by the consumer.
+    alignas(64) std::size_t head = 0;
+};
+
+template <typename T>
+MpscRing<T>::MpscRing(std::size_t capacity) :
+    mask{ roundUp(capacity) - 1 },
+    cells{ new Cell[mask + 1] }
+{
+    // The cell of position p is free for the producer of p when its sequence is p.
+    for(std::size_t i = 0; i <= mask; ++i)
+    {
+        cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+}
+
+template <typename T>
+bool MpscRing<T>::tryPush(T&& value)
+{
+    std::size_t position = tail.load(std::memory_order_relaxed);
+
+    for(;;)
+    {
+        Cell& cell = cells[position & mask];
+
+        const std::size_t sequence = cell.sequence.load(std::memory_order_acquire);
+        const auto lag = static_cast<std::ptrdiff_t>(sequence - position);
+
+        if(0 == lag)
+        {
+            if(tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+            {
+                cell.value = std::move(value);
+                cell.sequence.store(position + 1, std::memory_order_release);
+
+                return true;
+            }
+        }
+        else if(lag < 0)
+        {
+            // The consumer has not taken the value of the previous lap yet.
+            return false;
+        }
+        else
+        {
+            // Another producer claimed the cell first.
+            position = tail.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+template <typename T>
+bool MpscRing<T>::tryPop(T& value)
+{
+    Cell& cell = cells[head & mask];
+
+    if(cell.sequence.load(std::memory_order_acquire) != head + 1)
+    {
+        return false;
+    }
+
+    value = std::move(cell.value);
+
+    // Free the cell for the producer of the next lap.
+    cell.sequence.store(head + mask + 1, std::memory_order_release);
+    ++head;
+
+    return true;
+}
+
+template <typename T>
+bool MpscRing<T>::empty() const noexcept
+{
+    return cells[head & mask].sequence.load(std::memory_order_acquire) != head + 1;
+}
+
+template <typename T>
+std::size_t MpscRing<T>::roundUp(std::size_t capacity) noexcept
+{
+    std::size_t rounded = 2;
+
+    while(rounded < capacity)
+    {
+        rounded *= 2;
+    }
+
+    return rounded;
+}
@@ -1,200 +1,1631 @@
 #include "OrderCache.h"
+#include "MappedFile.h"
+#include "QtyFilter.h"
+#include "Snapshot.h"
 
 #include <algorithm>
-#include <set>
-#include <map>
+#include <atomic>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+
+namespace
+{
+    // Securities handed to a worker at a time: large enough to amortize taking them,
+    // small enough to even out books of very different sizes.
+    constexpr std::size_t parallel_chunk = 1024;
+
+    // Positions of the old order id table moved into the new one by every call adding or
+    // removing orders while the table shrinks; compact moves the rest.
+    constexpr std::size_t order_id_shrink_step = 64;
+
+    // Call work(begin, end) over chunks of [0, count) on up to threads threads, the calling
+    // thread included; 0 threads means one per hardware thread. Return when all chunks are done.
+    template <typename Work>
+    void parallelFor(std::size_t count, std::size_t threads, Work work)
+    {
+        if(0 == threads)
+        {
+            threads = std::max(1u, std::thread::hardware_concurrency());
+        }
+
+        threads = std::min(threads, (count + parallel_chunk - 1) / parallel_chunk);
+
+        if(threads <= 1)
+        {
+            work(std::size_t{ 0 }, count);
+            return;
+        }
+
+        std::atomic<std::size_t> next_chunk{ 0 };
+
+        const auto worker = [&]
+        {
+            for(std::size_t begin; (begin = next_chunk.fetch_add(parallel_chunk, std::memory_order_relaxed)) < count; )
+            {
+                work(begin, std::min(begin + parallel_chunk, count));
+            }
+        };
+
+        std::vector<std::thread> helpers;
+        helpers.reserve(threads - 1);
+
+        for(std::size_t t = 1; t < threads; ++t)
+        {
+            helpers.emplace_back(worker);
+        }
+
+        worker();
+
+        for(std::thread& helper : helpers)
+        {
+            helper.join();
+        }
+    }
+}
 
 void OrderCache::addOrder(Order order)
 {
-    if(const auto& [it_order, inserted] = orders_table.insert(order); inserted)
+    const OrderCacheCounters::Call call{ counters, CacheMethod::AddOrder };
+
+    if(const OrderSlot slot = storeOrder(order); OrdersTableType::none != slot)
     {
-        addOrderToIndex(security_index, it_order->securityId(), it_order);
-        addOrderToIndex(user_index, it_order->user(), it_order);
-        addOrderToIndex(company_index, it_order->company(), it_order);
+        indexOrder(slot);
+        finishChange();
     }
 }
 
 void OrderCache::cancelOrder(const std::string& orderId)
 {
-    class IdOnlyOrder : public Order
+    const OrderCacheCounters::Call call{ counters, CacheMethod::CancelOrder };
+
+    if(const OrderSlot slot = orders_table.find(orderId, store); OrdersTableType::none != slot)
     {
-    public:
-        explicit IdOnlyOrder(const std::string& orderId) :
-            Order{ orderId, "", "", 0, "", "" }
-        {
-        }
-    };
+        removeOrder(slot);
+        finishChange();
+    }
+}
+
+void OrderCache::cancelOrdersForUser(const std::string& user)
+{
+    OrderCacheCounters::Call call{ counters, CacheMethod::CancelOrdersForUser };
+
+    call.scanned(cancelUserOrders(user, [](OrderSlot) {}));
+    finishChange();
+}
+
+void OrderCache::cancelOrdersForUser(const std::string& user, std::vector<std::string>& cancelled)
+{
+    OrderCacheCounters::Call call{ counters, CacheMethod::CancelOrdersForUser };
+
+    call.scanned(cancelUserOrders(user, [&](OrderSlot slot) { cancelled.emplace_back(store.order_id[slot]); }));
+    finishChange();
+}
+
+void OrderCache::cancelOrdersForCompany(const std::string& company)
+{
+    OrderCacheCounters::Call call{ counters, CacheMethod::CancelOrdersForCompany };
+
+    call.scanned(cancelCompanyOrders(company, [](OrderSlot) {}));
+    finishChange();
+}
+
+void OrderCache::cancelOrdersForCompany(const std::string& company, std::vector<std::string>& cancelled)
+{
+    OrderCacheCounters::Call call{ counters, CacheMethod::CancelOrdersForCompany };
 
-    // An iterator to the order is needed to remove it form the indexes.
-    const auto it_order = orders_table.find(IdOnlyOrder{ orderId });
+    call.scanned(cancelCompanyOrders(company, [&](OrderSlot slot) { cancelled.emplace_back(store.order_id[slot]); }));
+    finishChange();
+}
+
+OrderCache::OpenQty OrderCache::getOpenQtyForCompany(const std::string& company, const std::string& securityId) const
+{
+    const SymbolId company_id = companies.find(company);
+    const SymbolId security_id = securities.find(securityId);
 
-    if(it_order != orders_table.end())
+    if(SymbolTable::none == company_id || SymbolTable::none == security_id || security_id >= security_books.size())
     {
-        removeOrderFromIndex(user_index, it_order);
-        removeOrderFromIndex(security_index, it_order);
-        removeOrderFromIndex(company_index, it_order);
+        return {};
+    }
 
-        orders_table.erase(it_order);
+    const CompanyQtyTable& company_qty = security_books[security_id].company_qty;
+
+    if(const auto it_company_qty = company_qty.find(company_id); it_company_qty != company_qty.end())
+    {
+        return { it_company_qty->second.buy, it_company_qty->second.sell };
     }
+
+    return {};
 }
 
-void OrderCache::cancelOrdersForUser(const std::string& user)
+OrderCache::OpenQty OrderCache::getOpenQtyForSecurityWithMinimumQty(const std::string& securityId, unsigned int minQty) const
+{
+    const SymbolId security_id = securities.find(securityId);
+
+    if(SymbolTable::none == security_id)
+    {
+        return {};
+    }
+
+    return { partition(security_id, Side::Buy).qtyAtLeast(minQty), partition(security_id, Side::Sell).qtyAtLeast(minQty) };
+}
+
+template <typename OnCancel>
+std::size_t OrderCache::cancelUserOrders(const std::string& user, OnCancel on_cancel)
+{
+    const SymbolId user_id = users.find(user);
+
+    if(user_id == SymbolTable::none)
+    {
+        return 0;
+    }
+
+    return cancelOrdersInBucket(user_index[user_id], company_index, &OrderStore::company, &OrderStore::company_pos, on_cancel);
+}
+
+template <typename OnCancel>
+std::size_t OrderCache::cancelCompanyOrders(const std::string& company, OnCancel on_cancel)
+{
+    const SymbolId company_id = companies.find(company);
+
+    if(company_id == SymbolTable::none || company_id >= company_index.size())
+    {
+        return 0;
+    }
+
+    return cancelOrdersInBucket(company_index[company_id], user_index, &OrderStore::user, &OrderStore::user_pos, on_cancel);
+}
+
+template <typename OnCancel>
+std::size_t OrderCache::cancelOrdersInBucket(IndexBucket& bucket, IndexType& other_index, IndexKey other_key, IndexPosition other_position, OnCancel on_cancel)
 {
-    // Get a range with all orders for the user.
-    auto [range_begin, range_end] = user_index.equal_range(user);
+    const std::size_t scanned = bucket.size();
 
-    // For every order in range...
-    for(auto& it = range_begin; it != range_end; ++it)
+    // For every order in the bucket...
+    for(const OrderSlot slot : bucket)
     {
-        auto& [key, it_order] = *it;
+        on_cancel(slot);
+
+        // ...remove it from its security book.
+        removeOrderFromBook(slot);
 
         // ...remove it from the other indexes.
-        removeOrderFromIndex(security_index, it_order);
-        removeOrderFromIndex(company_index, it_order);
+        removeOrderFromSecurityIndex(slot);
+        removeOrderFromIndex(other_index, (store.*other_key)[slot], slot, other_position);
 
-        // ...remove it from the orders table.
-        orders_table.erase(it_order);
+        // ...remove it from the orders table and the store.
+        orders_table.erase(store.order_id[slot], slot);
+        store.release(slot);
     }
 
-    // Finally remove the key (and all its orders) from the index.
-    user_index.erase(user);
+    // Finally remove all orders from the bucket.
+    bucket.clear();
+
+    return scanned;
 }
 
 void OrderCache::cancelOrdersForSecIdWithMinimumQty(const std::string& securityId, unsigned int minQty)
 {
-    // Get a range with all orders for the security.
-    auto [range_begin, range_end] = security_index.equal_range(securityId);
+    OrderCacheCounters::Call call{ counters, CacheMethod::CancelOrdersForSecIdWithMinimumQty };
+
+    call.scanned(cancelSecurityOrdersWithMinimumQty(securityId, minQty, [](OrderSlot) {}));
+    finishChange();
+}
+
+void OrderCache::cancelOrdersForSecIdWithMinimumQty(const std::string& securityId, unsigned int minQty, std::vector<std::string>& cancelled)
+{
+    OrderCacheCounters::Call call{ counters, CacheMethod::CancelOrdersForSecIdWithMinimumQty };
+
+    call.scanned(cancelSecurityOrdersWithMinimumQty(securityId, minQty, [&](OrderSlot slot) { cancelled.emplace_back(store.order_id[slot]); }));
+    finishChange();
+}
 
-    auto& it = range_begin;
+template <typename OnCancel>
+std::size_t OrderCache::cancelSecurityOrdersWithMinimumQty(const std::string& securityId, unsigned int minQty, OnCancel on_cancel)
+{
+    const SymbolId security_id = securities.find(securityId);
 
-    while(it != range_end)
+    if(security_id == SymbolTable::none)
     {
-        auto& [key, it_order] = *it;
+        return 0;
+    }
 
-        // If order's qty is greater than minQty...
-        if(it_order->qty() >= minQty)
-        {
-            // ...remove the order from the other indexes.
-            removeOrderFromIndex(user_index, it_order);
-            removeOrderFromIndex(company_index, it_order);
+    std::size_t scanned = 0;
 
-            // ...remove the order from the orders table.
-            orders_table.erase(it_order);
+    const std::uint32_t boundary_bucket = QtyLadder::bucketOf(minQty);
 
-            // ...remove the order from the security index itself.
-            it = security_index.erase(it);
+    for(const Side side : { Side::Buy, Side::Sell })
+    {
+        const SymbolId key = partitionOf(security_id, side);
+
+        if(key >= security_index.size())
+        {
+            break;
         }
-        else
+
+        // Removing orders never moves a rung, only compact does, so the rungs can be walked while orders go.
+        const QtyLadder& ladder = security_index[key];
+
+        for(std::size_t rank = ladder.rungCount(), first = ladder.firstRungFrom(minQty); rank-- > first; )
         {
-            // The order has qty smaller than minQty. Move to the next order.
-            it = std::next(it);
+            const QtyLadder::Rung& rung = ladder.rungByQty(rank);
+
+            scanned += rung.size();
+
+            // Every order of a rung above the one of minQty is to cancel, from the last one down.
+            if(rung.bucket != boundary_bucket)
+            {
+                for(std::size_t position = rung.size(); position-- > 0; )
+                {
+                    const OrderSlot slot = rung.slots[position];
+
+                    on_cancel(slot);
+                    removeOrder(slot);
+                }
+
+                continue;
+            }
+
+            // Rungs left empty by removals are kept until compacted.
+            if(0 == rung.size())
+            {
+                continue;
+            }
+
+            // In the rung of minQty, mark the orders to cancel and remove them from the highest
+            // position down: removing an order moves the last order of the rung into its position,
+            // which has been visited already and is not one to cancel.
+            victim_mask.resize(qtyMaskWords(rung.size()));
+
+            if(0 == selectQtyAtLeast(rung.qtys.data(), rung.size(), minQty, victim_mask.data()))
+            {
+                continue;
+            }
+
+            for(std::size_t word = qtyMaskWords(rung.size()); word-- > 0; )
+            {
+                for(std::uint64_t bits = victim_mask[word]; 0 != bits; )
+                {
+                    const std::size_t bit = highestSetBit(bits);
+                    bits &= ~(std::uint64_t{ 1 } << bit);
+
+                    const OrderSlot slot = rung.slots[word * 64 + bit];
+
+                    on_cancel(slot);
+                    removeOrder(slot);
+                }
+            }
         }
     }
+
+    return scanned;
 }
 
 unsigned int OrderCache::getMatchingSizeForSecurity(const std::string& securityId)
 {
     /*
-       The idea is to:
-       -    aggregate qty of companies to limit the number of iterations
-       -    sort buy and sell company qty in opposite direction to let qty from the same company
-            to be matched with other companies before they hit themselves
+       Every buy qty can match every sell qty except the one of its own company, so the matched qty
+       is limited by:
+       -    the total buy qty and the total sell qty
+       -    the qty of the largest company: its buy qty can only match the other companies' sell qty
+            and vice versa, so at most (total_buy + total_sell - max_company_total) can match
+       The smallest of the three limits is always achievable.
     */
 
-    unsigned int total_matched_qty = 0;
+    OrderCacheCounters::Call call{ counters, CacheMethod::GetMatchingSizeForSecurity };
+
+    const SymbolId security_id = securities.find(securityId);
+
+    if(security_id == SymbolTable::none)
+    {
+        return 0;
+    }
+
+    SecurityBook& book = security_books[security_id];
+
+    counters.matchingSizeCached(!book.matching_size_dirty);
+    call.scanned(updateMatchingSize(book));
+
+    return book.matching_size;
+}
 
-    // SELECT company, SUM(qty) FROM orders WHERE securityId = ? AND side = 'Sell' GROUP BY company ORDER BY company ASC
-    std::map<std::string, unsigned int, std::less<std::string>> sell_company_qty;
+OrderCache::MatchingSizes OrderCache::getMatchingSizeForAllSecurities(std::size_t threads)
+{
+    updateMatchingSizes(threads);
 
-    // SELECT company, SUM(qty) FROM orders WHERE securityId = ? AND side = 'Buy' GROUP BY company ORDER BY company DESC
-    std::map<std::string, unsigned int, std::greater<std::string>> buy_company_qty;
+    MatchingSizes result;
 
-    // Get a range with all orders for the security.
-    auto [range_begin, range_end] = security_index.equal_range(securityId);
+    result.security_ids.resize(securities.size());
+    result.sizes.resize(securities.size());
 
-    // Get orders qty aggregated by company.
-    for(auto it = range_begin; it != range_end; ++it)
+    for(SymbolId security_id = 0; security_id < securities.size(); ++security_id)
     {
-        const auto& [key, it_order] = *it;
+        result.security_ids[security_id] = securities.name(security_id);
+        result.sizes[security_id] = security_id < security_books.size() ? security_books[security_id].matching_size : 0;
+    }
+
+    return result;
+}
+
+std::vector<unsigned int> OrderCache::getMatchingSizeForSecurities(const std::vector<std::string>& securityIds, std::size_t threads)
+{
+    updateMatchingSizes(threads);
+
+    std::vector<unsigned int> sizes(securityIds.size());
 
-        if(it_order->side() == "Sell")
+    // Every book is up to date now, so the lookups only read and can run in parallel too.
+    parallelFor(securityIds.size(), threads, [&](std::size_t begin, std::size_t end)
+    {
+        for(std::size_t i = begin; i < end; ++i)
         {
-            sell_company_qty[it_order->company()] += it_order->qty();
+            const SymbolId security_id = securities.find(securityIds[i]);
+
+            sizes[i] = security_id < security_books.size() ? security_books[security_id].matching_size : 0;
         }
-        else
+    });
+
+    return sizes;
+}
+
+void OrderCache::updateMatchingSizes(std::size_t threads)
+{
+    // Each book belongs to one range of security ids, so the workers never share a book.
+    parallelFor(security_books.size(), threads, [this](std::size_t begin, std::size_t end)
+    {
+        for(std::size_t security_id = begin; security_id < end; ++security_id)
         {
-            buy_company_qty[it_order->company()] += it_order->qty();
+            updateMatchingSize(security_books[security_id]);
         }
+    });
+}
+
+std::size_t OrderCache::updateMatchingSize(SecurityBook& book) noexcept
+{
+    if(!book.matching_size_dirty)
+    {
+        return 0;
     }
 
-    //---
+    std::size_t scanned = 0;
 
-    for(auto& [sell_company, sell_remaining_qty] : sell_company_qty)
+    if(book.max_company_total_stale)
     {
-        for(auto& [buy_company, buy_remaining_qty] : buy_company_qty)
+        scanned = book.company_qty.size();
+
+        book.max_company_total = 0;
+
+        for(const auto& [company, qty] : book.company_qty)
         {
-            // Do not match qty from the same company.
-            // Skip already fully matched qty.
-            if(sell_company == buy_company || 0 == buy_remaining_qty)
-            {
-                continue; // Continue to the buy qty of the next company.
-            }
+            book.max_company_total = std::max(book.max_company_total, qty.total());
+        }
 
-            if(sell_remaining_qty > buy_remaining_qty)
-            {
-                const unsigned int matched_qty = buy_remaining_qty;
+        book.max_company_total_stale = false;
+    }
 
-                total_matched_qty += matched_qty;
+    const unsigned long long matched_qty = std::min({
+        book.total_buy,
+        book.total_sell,
+        book.total_buy + book.total_sell - book.max_company_total
+    });
 
-                sell_remaining_qty -= matched_qty;
-                buy_remaining_qty = 0;
+    book.matching_size = static_cast<unsigned int>(matched_qty);
+    book.matching_size_dirty = false;
 
-                continue; // The remaining qty for the long side has been depleted.
-                          // Continue to the buy qty of the next company.
-            }
-            else if(sell_remaining_qty <= buy_remaining_qty)
-            {
-                const unsigned int matched_qty = sell_remaining_qty;
+    return scanned;
+}
 
-                total_matched_qty += matched_qty;
+std::vector<Order> OrderCache::getAllOrders() const
+{
+    OrderCacheCounters::Call call{ counters, CacheMethod::GetAllOrders };
+    call.scanned(store.size());
 
-                sell_remaining_qty = 0;
-                buy_remaining_qty -= matched_qty;
+    std::vector<Order> orders;
+    orders.reserve(store.size());
 
-                break; // The remaining qty for the short side has been depleted.
-                       // Stop processing the buy qty and continue to the sell qty of the next company.
-            }
+    for(OrderSlot slot = 0; slot < store.slotCount(); ++slot)
+    {
+        if(!store.isLive(slot))
+        {
+            continue;
         }
+
+        orders.emplace_back(
+            std::string{ store.order_id[slot] },
+            securities.name(store.security[slot]),
+            sideName(store.side[slot]),
+            store.qty[slot],
+            users.name(store.user[slot]),
+            companies.name(store.company[slot])
+        );
     }
 
-    return total_matched_qty;
+    return orders;
 }
 
-std::vector<Order> OrderCache::getAllOrders() const
+OrderView OrderCache::viewOf(OrderSlot slot) const
 {
-    return std::vector<Order>{ std::begin(orders_table), std::end(orders_table) };
+    return {
+        store.order_id[slot],
+        securities.name(store.security[slot]),
+        sideName(store.side[slot]),
+        store.qty[slot],
+        users.name(store.user[slot]),
+        companies.name(store.company[slot])
+    };
 }
 
-void OrderCache::addOrderToIndex(IndexType& index, const std::string& key, const OrderIterator& it_order)
+void OrderCache::addOrders(const std::vector<Order>& orders)
 {
-    index.insert(std::make_pair(key, it_order));
+    orders_table.reserve(orders_table.size() + orders.size());
+    store.reserve(orders.size());
+
+    std::vector<OrderSlot> slots;
+    slots.reserve(orders.size());
+
+    // Store the orders, dropping duplicates within the batch and of orders already in the cache.
+    for(const Order& order : orders)
+    {
+        if(const OrderSlot slot = storeOrder(order); OrdersTableType::none != slot)
+        {
+            slots.push_back(slot);
+        }
+    }
+
+    // Group the new orders by security index partition, so every book and bucket is visited in one go.
+    // The sort costs the size of the batch only; being stable, it keeps the orders of a partition in batch order.
+    std::vector<OrderSlot> slots_by_security = slots;
+
+    std::stable_sort(slots_by_security.begin(), slots_by_security.end(), [this](OrderSlot a, OrderSlot b)
+    {
+        return partitionOf(store.security[a], store.side[a]) < partitionOf(store.security[b], store.side[b]);
+    });
+
+    // Update the books and each index in a pass of its own.
+    for(const OrderSlot slot : slots_by_security)
+    {
+        addOrderToBook(slot);
+        addOrderToSecurityIndex(slot);
+    }
+
+    for(const OrderSlot slot : slots)
+    {
+        addOrderToIndex(user_index, store.user[slot], slot, &OrderStore::user_pos);
+    }
+
+    for(const OrderSlot slot : slots)
+    {
+        addOrderToIndex(company_index, store.company[slot], slot, &OrderStore::company_pos);
+    }
+
+    finishChange();
 }
 
-void OrderCache::removeOrderFromIndex(IndexType& index, const OrderIterator& it_order)
+void OrderCache::cancelOrders(const std::vector<std::string_view>& orderIds)
 {
-    auto it = index.begin(); 
-    
-    while(it != index.end())
+    std::vector<OrderSlot> slots;
+    slots.reserve(orderIds.size());
+
+    for(const std::string_view order_id : orderIds)
     {
-        if(it->second == it_order)
+        if(const OrderSlot slot = orders_table.find(order_id, store); OrdersTableType::none != slot)
         {
-            it = index.erase(it);
+            slots.push_back(slot);
+        }
+    }
 
-            break;
+    // The same order id may be in the batch more than once.
+    std::sort(slots.begin(), slots.end());
+    slots.erase(std::unique(slots.begin(), slots.end()), slots.end());
+
+    // Update the books and each index in a pass of its own.
+    for(const OrderSlot slot : slots)
+    {
+        removeOrderFromBook(slot);
+    }
+
+    for(const OrderSlot slot : slots)
+    {
+        removeOrderFromSecurityIndex(slot);
+    }
+
+    for(const OrderSlot slot : slots)
+    {
+        removeOrderFromIndex(user_index, store.user[slot], slot, &OrderStore::user_pos);
+    }
+
+    for(const OrderSlot slot : slots)
+    {
+        removeOrderFromIndex(company_index, store.company[slot], slot, &OrderStore::company_pos);
+    }
+
+    for(const OrderSlot slot : slots)
+    {
+        orders_table.erase(store.order_id[slot], slot);
+        store.release(slot);
+    }
+
+    finishChange();
+}
+
+void OrderCache::clear()
+{
+    for(SymbolId key = 0; key < security_index.size(); ++key)
+    {
+        if(!security_index[key].empty())
+        {
+            markChanged(key / side_count);
+        }
+
+        security_index[key].clear();
+    }
+
+    for(IndexBucket& bucket : user_index)
+    {
+        bucket.clear();
+    }
+
+    for(IndexBucket& bucket : company_index)
+    {
+        bucket.clear();
+    }
+
+    for(SecurityBook& book : security_books)
+    {
+        book.company_qty.clear();
+        book.total_buy = 0;
+        book.total_sell = 0;
+        book.max_company_total = 0;
+        book.max_company_total_stale = false;
+    }
+
+    orders_table.clear();
+    store.clear();
+
+    finishChange();
+}
+
+void OrderCache::amendQty(const std::string& orderId, unsigned int qty)
+{
+    const OrderSlot slot = orders_table.find(orderId, store);
+
+    if(OrdersTableType::none == slot)
+    {
+        return;
+    }
+
+    // An order added with qty 0 is removed too.
+    if(0 == qty)
+    {
+        removeOrder(slot);
+    }
+    else if(qty != store.qty[slot])
+    {
+        changeOrderQty(slot, qty);
+    }
+    else
+    {
+        return;
+    }
+
+    finishChange();
+}
+
+void OrderCache::reduceQty(const std::string& orderId, unsigned int delta)
+{
+    const OrderSlot slot = orders_table.find(orderId, store);
+
+    if(OrdersTableType::none == slot || 0 == delta)
+    {
+        return;
+    }
+
+    if(delta >= store.qty[slot])
+    {
+        removeOrder(slot);
+    }
+    else
+    {
+        changeOrderQty(slot, store.qty[slot] - delta);
+    }
+
+    finishChange();
+}
+
+OrderCache::CompactProgress OrderCache::compact(std::size_t work_limit)
+{
+    using Phase = Compaction::Phase;
+
+    std::size_t work = std::max<std::size_t>(work_limit, 1);
+
+    // The store and the order id table count their bytes at once; the steps on the indexes and
+    // books add up what they give back, so that no call walks the whole cache but the last.
+    const std::size_t flat_bytes = store.memoryBytes() + orders_table.memoryBytes();
+    std::size_t released = 0;
+
+    // Each phase goes on until it is through or the work runs out, then hands over to the next.
+    if(Phase::Store == compaction.phase)
+    {
+        for(; work > 0 && !store.dense(); --work)
+        {
+            compactLastSlot();
         }
-        else
+
+        if(store.dense())
         {
-            it = std::next(it);
+            compaction.phase = Phase::StoreColumns;
+            compaction.next = 0;
         }
     }
+
+    if(Phase::StoreColumns == compaction.phase)
+    {
+        for(; work > 0 && compaction.next < OrderStore::column_count; ++compaction.next)
+        {
+            store.shrinkColumn(compaction.next);
+
+            work -= std::min(work, 1 + store.slotCount());
+        }
+
+        if(compaction.next == OrderStore::column_count)
+        {
+            store.shrinkFreeSlots();
+
+            compaction.phase = Phase::SecurityIndex;
+            compaction.next = 0;
+            compaction.rung = 0;
+        }
+    }
+
+    if(Phase::SecurityIndex == compaction.phase)
+    {
+        const auto renumber = [this](OrderSlot slot, QtyLadder::RungIndex rung)
+        {
+            store.security_rung[slot] = rung;
+        };
+
+        while(work > 0 && compaction.next < security_index.size())
+        {
+            QtyLadder& ladder = security_index[compaction.next];
+
+            if(compaction.rung < ladder.rungCount())
+            {
+                const std::size_t rungs = ladder.rungCount();
+
+                work -= std::min(work, 1 + ladder.compactRung(static_cast<QtyLadder::RungIndex>(compaction.rung), renumber, released));
+
+                // A dropped rung leaves its index to the last one, which is looked at next.
+                if(ladder.rungCount() == rungs)
+                {
+                    ++compaction.rung;
+                }
+
+                continue;
+            }
+
+            released += ladder.shrinkRungs();
+            work -= std::min(work, 1 + ladder.rungCount());
+
+            ++compaction.next;
+            compaction.rung = 0;
+        }
+
+        if(compaction.next == security_index.size())
+        {
+            compaction.phase = Phase::UserIndex;
+            compaction.next = 0;
+        }
+    }
+
+    if(Phase::UserIndex == compaction.phase)
+    {
+        work = compactIndex(user_index, compaction.next, work, released);
+
+        if(compaction.next == user_index.size())
+        {
+            compaction.phase = Phase::CompanyIndex;
+            compaction.next = 0;
+        }
+    }
+
+    if(Phase::CompanyIndex == compaction.phase)
+    {
+        work = compactIndex(company_index, compaction.next, work, released);
+
+        if(compaction.next == company_index.size())
+        {
+            compaction.phase = Phase::SecurityBooks;
+            compaction.next = 0;
+        }
+    }
+
+    if(Phase::SecurityBooks == compaction.phase)
+    {
+        for(; work > 0 && compaction.next < security_books.size(); ++compaction.next)
+        {
+            CompanyQtyTable& company_qty = security_books[compaction.next].company_qty;
+
+            if(const std::size_t bucket_count = company_qty.bucket_count(); bucket_count > 2 * company_qty.size())
+            {
+                company_qty.rehash(0);
+
+                released += (bucket_count - std::min(bucket_count, company_qty.bucket_count())) * sizeof(void*);
+            }
+
+            work -= std::min(work, 1 + company_qty.size());
+        }
+
+        if(compaction.next == security_books.size())
+        {
+            compaction.phase = Phase::OrderIdTable;
+            compaction.next = 0;
+        }
+    }
+
+    // Calls adding or removing orders move the table on too, see finishChange.
+    if(Phase::OrderIdTable == compaction.phase && work > 0)
+    {
+        work = orders_table.shrink(work);
+
+        if(!orders_table.shrinking())
+        {
+            compaction.phase = Phase::OrderIds;
+        }
+    }
+
+    CompactProgress progress;
+
+    if(Phase::OrderIds == compaction.phase && work > 0)
+    {
+        store.compactOrderIds(work);
+
+        if(!store.compactingOrderIds())
+        {
+            changed_securities.shrink_to_fit();
+            pending_notifications.shrink_to_fit();
+
+            progress.done = true;
+        }
+    }
+
+    compaction.released += static_cast<long long>(released + flat_bytes) - static_cast<long long>(store.memoryBytes() + orders_table.memoryBytes());
+
+    publishGauges();
+
+    if(progress.done)
+    {
+        progress.bytes_after = memoryBytes();
+        progress.bytes_before = progress.bytes_after + static_cast<std::size_t>(std::max(compaction.released, 0LL));
+
+        compaction = {};
+    }
+
+    return progress;
+}
+
+std::size_t OrderCache::memoryBytes() const noexcept
+{
+    std::size_t bytes = store.memoryBytes() + orders_table.memoryBytes();
+
+    bytes += security_index.capacity() * sizeof(QtyLadder);
+
+    for(const QtyLadder& ladder : security_index)
+    {
+        bytes += ladder.memoryBytes();
+    }
+
+    for(const IndexType* index : { &user_index, &company_index })
+    {
+        bytes += index->capacity() * sizeof(IndexBucket);
+
+        for(const IndexBucket& bucket : *index)
+        {
+            bytes += bucket.capacity() * sizeof(OrderSlot);
+        }
+    }
+
+    bytes += security_books.capacity() * sizeof(SecurityBook);
+
+    // Each company of a book is a node linking to the next, plus a bucket pointing to it.
+    for(const SecurityBook& book : security_books)
+    {
+        bytes += book.company_qty.bucket_count() * sizeof(void*) + book.company_qty.size() * (sizeof(CompanyQtyTable::value_type) + sizeof(void*));
+    }
+
+    return bytes;
+}
+
+bool OrderCache::containsOrder(const std::string& orderId) const
+{
+    return OrdersTableType::none != orders_table.find(orderId, store);
+}
+
+void OrderCache::takeChangedSecurities(std::vector<std::string>& changed)
+{
+    for(const SymbolId security_id : changed_securities)
+    {
+        security_books[security_id].changed = false;
+
+        changed.push_back(securities.name(security_id));
+    }
+
+    changed_securities.clear();
+}
+
+void OrderCache::takeChangedSecurities(std::vector<std::string>& changed, std::vector<unsigned int>& sizes)
+{
+    for(const SymbolId security_id : changed_securities)
+    {
+        SecurityBook& book = security_books[security_id];
+
+        book.changed = false;
+        updateMatchingSize(book);
+
+        changed.push_back(securities.name(security_id));
+        sizes.push_back(book.matching_size);
+    }
+
+    changed_securities.clear();
+}
+
+void OrderCache::subscribeMatchingSize(const std::string& securityId)
+{
+    const SymbolId security_id = securities.intern(securityId);
+
+    if(security_id >= security_books.size())
+    {
+        security_books.resize(security_id + 1);
+    }
+
+    SecurityBook& book = security_books[security_id];
+
+    if(book.subscribed)
+    {
+        return;
+    }
+
+    // Changes are reported from the current size on.
+    updateMatchingSize(book);
+
+    book.subscribed = true;
+    book.notified_size = book.matching_size;
+}
+
+void OrderCache::unsubscribeMatchingSize(const std::string& securityId)
+{
+    const SymbolId security_id = securities.find(securityId);
+
+    // A pending notification of the security stays queued and is dropped when taken.
+    if(security_id < security_books.size())
+    {
+        security_books[security_id].subscribed = false;
+    }
+}
+
+void OrderCache::setMatchingSizeListener(MatchingSizeListener listener)
+{
+    matching_size_listener = std::move(listener);
+
+    // Hand over what was queued before, so no change is missed.
+    finishChange();
+}
+
+void OrderCache::takeMatchingSizeChanges(std::vector<MatchingSizeChange>& changes)
+{
+    for(const SymbolId security_id : pending_notifications)
+    {
+        SecurityBook& book = security_books[security_id];
+
+        book.notification_pending = false;
+
+        if(!book.subscribed)
+        {
+            continue;
+        }
+
+        // The book totals are kept up to date by every mutation, so this reads them only,
+        // unless the largest company lost qty.
+        updateMatchingSize(book);
+
+        if(book.matching_size != book.notified_size)
+        {
+            changes.push_back({ securities.name(security_id), book.notified_size, book.matching_size });
+
+            book.notified_size = book.matching_size;
+        }
+    }
+
+    pending_notifications.clear();
+}
+
+namespace
+{
+    constexpr char snapshot_magic[8] = { 'O', 'C', 'S', 'N', 'A', 'P', 0, 0 };
+    constexpr std::uint32_t snapshot_version = 6;
+
+    // Book entry of one company of one security, as stored in a snapshot.
+    // The padding is spelled out, so that the bytes written are all set.
+    struct SnapshotCompanyQty
+    {
+        SymbolId company;
+        unsigned int buy;
+        unsigned int sell;
+        std::uint32_t padding;
+        std::uint64_t orders;
+    };
+
+    static_assert(sizeof(SnapshotCompanyQty) == 24);
+}
+
+void OrderCache::saveSnapshot(const std::string& path, std::uint64_t journal_position) const
+{
+    SnapshotWriter writer{ path };
+
+    for(const char c : snapshot_magic)
+    {
+        writer.value(c);
+    }
+
+    writer.value(snapshot_version);
+
+    // Lets a reader notice a snapshot written with another byte order or type sizes.
+    writer.value(std::uint32_t{ 0x01020304 });
+    writer.value(static_cast<std::uint32_t>(sizeof(unsigned int)));
+
+    writer.value(journal_position);
+
+    securities.save(writer);
+    users.save(writer);
+    companies.save(writer);
+
+    store.save(writer);
+    orders_table.save(writer);
+
+    writer.value(static_cast<std::uint64_t>(security_index.size()));
+
+    for(const QtyLadder& ladder : security_index)
+    {
+        ladder.save(writer);
+    }
+
+    saveIndex(writer, user_index);
+    saveIndex(writer, company_index);
+
+    writer.value(static_cast<std::uint64_t>(security_books.size()));
+
+    std::vector<SnapshotCompanyQty> company_qty;
+
+    for(const SecurityBook& book : security_books)
+    {
+        writer.value(book.total_buy);
+        writer.value(book.total_sell);
+        writer.value(book.max_company_total);
+        writer.value(static_cast<std::uint8_t>(book.max_company_total_stale));
+        writer.value(static_cast<std::uint8_t>(book.changed));
+
+        company_qty.clear();
+
+        for(const auto& [company, qty] : book.company_qty)
+        {
+            company_qty.push_back({ company, qty.buy, qty.sell, 0, qty.orders });
+        }
+
+        writer.array(company_qty);
+    }
+
+    writer.array(changed_securities);
+
+    writer.finish();
+}
+
+std::uint64_t OrderCache::loadSnapshot(const std::string& path, SnapshotCheck check)
+{
+    const MappedFile file{ path };
+    SnapshotReader reader{ file.data(), file.size() };
+
+    for(const char c : snapshot_magic)
+    {
+        if(reader.value<char>() != c)
+        {
+            throw std::runtime_error{ path + " is not an order cache snapshot" };
+        }
+    }
+
+    if(reader.value<std::uint32_t>() != snapshot_version
+        || reader.value<std::uint32_t>() != 0x01020304
+        || reader.value<std::uint32_t>() != sizeof(unsigned int))
+    {
+        throw std::runtime_error{ path + " is a snapshot of an unsupported version or platform" };
+    }
+
+    reader.checkChecksum();
+
+    const auto journal_position = reader.value<std::uint64_t>();
+
+    // Load into a new cache, so a bad snapshot leaves this one as it was.
+    OrderCache cache;
+
+    cache.securities.load(reader);
+    cache.users.load(reader);
+    cache.companies.load(reader);
+
+    cache.store.load(reader);
+    cache.orders_table.load(reader);
+
+    // Check a count before making room for it, so a bad one throws instead of exhausting memory.
+    if(const auto partitions = reader.value<std::uint64_t>(); partitions <= cache.securities.size() * side_count)
+    {
+        cache.security_index.resize(static_cast<std::size_t>(partitions));
+    }
+    else
+    {
+        throw std::runtime_error{ path + " has a bad security index" };
+    }
+
+    for(QtyLadder& ladder : cache.security_index)
+    {
+        ladder.load(reader);
+    }
+
+    loadIndex(reader, cache.user_index, cache.users.size());
+    loadIndex(reader, cache.company_index, cache.companies.size());
+
+    // Every security interned has a book.
+    if(reader.value<std::uint64_t>() != cache.securities.size())
+    {
+        throw std::runtime_error{ path + " has a bad number of security books" };
+    }
+
+    cache.security_books.resize(cache.securities.size());
+
+    std::vector<SnapshotCompanyQty> company_qty;
+
+    for(SecurityBook& book : cache.security_books)
+    {
+        book.total_buy = reader.value<unsigned long long>();
+        book.total_sell = reader.value<unsigned long long>();
+        book.max_company_total = reader.value<unsigned long long>();
+        book.max_company_total_stale = 0 != reader.value<std::uint8_t>();
+        book.changed = 0 != reader.value<std::uint8_t>();
+
+        reader.array(company_qty);
+
+        book.company_qty.reserve(company_qty.size());
+
+        for(const SnapshotCompanyQty& qty : company_qty)
+        {
+            CompanyQty& entry = book.company_qty[qty.company];
+
+            entry.buy = qty.buy;
+            entry.sell = qty.sell;
+            entry.orders = static_cast<std::size_t>(qty.orders);
+        }
+    }
+
+    reader.array(cache.changed_securities);
+
+    if(!reader.atEnd())
+    {
+        throw std::runtime_error{ path + " has unexpected data at the end" };
+    }
+
+    if(SnapshotCheck::References == check)
+    {
+        cache.checkLoaded();
+    }
+
+    // Rejections are counted per cache object, not saved with the orders.
+    cache.rejected_orders = rejected_orders;
+
+    // So are subscriptions, which carry over with the sizes last reported; every subscribed
+    // security is checked for a change against the loaded orders.
+    for(SymbolId security_id = 0; security_id < security_books.size(); ++security_id)
+    {
+        if(!security_books[security_id].subscribed)
+        {
+            continue;
+        }
+
+        const SymbolId loaded_id = cache.securities.intern(securities.name(security_id));
+
+        if(loaded_id >= cache.security_books.size())
+        {
+            cache.security_books.resize(loaded_id + 1);
+        }
+
+        SecurityBook& book = cache.security_books[loaded_id];
+
+        book.subscribed = true;
+        book.notification_pending = true;
+        book.notified_size = security_books[security_id].notified_size;
+
+        cache.pending_notifications.push_back(loaded_id);
+    }
+
+    cache.matching_size_listener = std::move(matching_size_listener);
+
+    *this = std::move(cache);
+
+    finishChange();
+
+    return journal_position;
+}
+
+void OrderCache::saveIndex(SnapshotWriter& writer, const std::vector<std::vector<std::uint32_t>>& index)
+{
+    writer.value(static_cast<std::uint64_t>(index.size()));
+
+    for(const auto& bucket : index)
+    {
+        writer.array(bucket);
+    }
+}
+
+void OrderCache::loadIndex(SnapshotReader& reader, std::vector<std::vector<std::uint32_t>>& index, std::size_t symbol_count)
+{
+    // Every name interned has a bucket.
+    if(reader.value<std::uint64_t>() != symbol_count)
+    {
+        throw std::runtime_error{ "snapshot has a bad number of index buckets" };
+    }
+
+    index.resize(symbol_count);
+
+    for(auto& bucket : index)
+    {
+        reader.array(bucket);
+    }
+}
+
+void OrderCache::checkLoaded() const
+{
+    orders_table.check(store);
+
+    // Each order found in its ladder entry and buckets, each entry and bucket holding one
+    // order, and the books the sums of their orders.
+    std::size_t indexed[3] = {};
+
+    for(const QtyLadder& ladder : security_index)
+    {
+        indexed[0] += ladder.size();
+    }
+
+    for(const IndexBucket& bucket : user_index)
+    {
+        indexed[1] += bucket.size();
+    }
+
+    for(const IndexBucket& bucket : company_index)
+    {
+        indexed[2] += bucket.size();
+    }
+
+    for(const std::size_t count : indexed)
+    {
+        if(count != store.size())
+        {
+            throw std::runtime_error{ "snapshot has an index not holding every order once" };
+        }
+    }
+
+    const auto holds = [this](const IndexType& index, SymbolId key, std::uint32_t position, OrderSlot slot)
+    {
+        return position < index[key].size() && index[key][position] == slot;
+    };
+
+    std::vector<CompanyQtyTable> books(security_books.size());
+
+    for(OrderSlot slot = 0; slot < store.slotCount(); ++slot)
+    {
+        if(!store.isLive(slot))
+        {
+            continue;
+        }
+
+        const SymbolId security_id = store.security[slot];
+        const SymbolId user_id = store.user[slot];
+        const SymbolId company_id = store.company[slot];
+
+        if(security_id >= securities.size() || user_id >= users.size() || company_id >= companies.size())
+        {
+            throw std::runtime_error{ "snapshot has an order of an unknown security, user or company" };
+        }
+
+        const SymbolId key = partitionOf(security_id, store.side[slot]);
+
+        if(key >= security_index.size() || !security_index[key].holds({ store.security_rung[slot], store.security_pos[slot] }, slot, store.qty[slot])
+            || !holds(user_index, user_id, store.user_pos[slot], slot)
+            || !holds(company_index, company_id, store.company_pos[slot], slot))
+        {
+            throw std::runtime_error{ "snapshot has an order missing from its index" };
+        }
+
+        CompanyQty& company_qty = books[security_id][company_id];
+
+        (Side::Sell == store.side[slot] ? company_qty.sell : company_qty.buy) += store.qty[slot];
+        ++company_qty.orders;
+    }
+
+    for(SymbolId security_id = 0; security_id < security_books.size(); ++security_id)
+    {
+        const SecurityBook& book = security_books[security_id];
+
+        unsigned long long total_buy = 0;
+        unsigned long long total_sell = 0;
+        unsigned long long max_company_total = 0;
+
+        bool same = book.company_qty.size() == books[security_id].size();
+
+        for(const auto& [company_id, qty] : books[security_id])
+        {
+            const auto it_company_qty = book.company_qty.find(company_id);
+
+            same = same && it_company_qty != book.company_qty.end() && it_company_qty->second.buy == qty.buy
+                && it_company_qty->second.sell == qty.sell && it_company_qty->second.orders == qty.orders;
+
+            total_buy += qty.buy;
+            total_sell += qty.sell;
+            max_company_total = std::max(max_company_total, qty.total());
+        }
+
+        if(!same || book.total_buy != total_buy || book.total_sell != total_sell
+            || (!book.max_company_total_stale && book.max_company_total != max_company_total))
+        {
+            throw std::runtime_error{ "snapshot has a security book not matching its orders" };
+        }
+    }
+
+    std::vector<bool> listed(security_books.size());
+
+    for(const SymbolId security_id : changed_securities)
+    {
+        if(security_id >= security_books.size() || !security_books[security_id].changed || listed[security_id])
+        {
+            throw std::runtime_error{ "snapshot has a bad list of changed securities" };
+        }
+
+        listed[security_id] = true;
+    }
+
+    if(changed_securities.size() != static_cast<std::size_t>(std::count_if(security_books.begin(), security_books.end(), [](const SecurityBook& book) { return book.changed; })))
+    {
+        throw std::runtime_error{ "snapshot has a bad list of changed securities" };
+    }
+}
+
+OrderSlot OrderCache::storeOrder(const Order& order)
+{
+    // Check the side before anything is interned for the order.
+    const std::optional<Side> side = parseSide(order.side());
+
+    if(!side)
+    {
+        ++rejected_orders;
+
+        return OrdersTableType::none;
+    }
+
+    const std::string order_id = order.orderId();
+
+    if(OrdersTableType::none != orders_table.find(order_id, store))
+    {
+        return OrdersTableType::none;
+    }
+
+    const OrderSlot slot = store.allocate();
+
+    store.setOrderId(slot, order_id);
+    store.qty[slot] = order.qty();
+    store.side[slot] = *side;
+    store.security[slot] = securities.intern(order.securityId());
+    store.user[slot] = users.intern(order.user());
+    store.company[slot] = companies.intern(order.company());
+
+    orders_table.insert(store.order_id[slot], slot);
+
+    return slot;
+}
+
+void OrderCache::indexOrder(OrderSlot slot)
+{
+    addOrderToBook(slot);
+
+    addOrderToSecurityIndex(slot);
+    addOrderToIndex(user_index, store.user[slot], slot, &OrderStore::user_pos);
+    addOrderToIndex(company_index, store.company[slot], slot, &OrderStore::company_pos);
+}
+
+void OrderCache::removeOrder(OrderSlot slot)
+{
+    removeOrderFromBook(slot);
+
+    removeOrderFromSecurityIndex(slot);
+    removeOrderFromIndex(user_index, store.user[slot], slot, &OrderStore::user_pos);
+    removeOrderFromIndex(company_index, store.company[slot], slot, &OrderStore::company_pos);
+
+    orders_table.erase(store.order_id[slot], slot);
+    store.release(slot);
+}
+
+void OrderCache::addOrderToSecurityIndex(OrderSlot slot)
+{
+    const SymbolId key = partitionOf(store.security[slot], store.side[slot]);
+
+    if(key >= security_index.size())
+    {
+        security_index.resize(key + 1);
+    }
+
+    const QtyLadder::Handle handle = security_index[key].add(slot, store.qty[slot]);
+
+    store.security_rung[slot] = handle.rung;
+    store.security_pos[slot] = handle.position;
+}
+
+void OrderCache::removeOrderFromSecurityIndex(OrderSlot slot)
+{
+    const SymbolId key = partitionOf(store.security[slot], store.side[slot]);
+
+    const QtyLadder::Handle handle{ store.security_rung[slot], store.security_pos[slot] };
+
+    if(const OrderSlot moved = security_index[key].remove(handle); QtyLadder::none != moved)
+    {
+        store.security_pos[moved] = store.security_pos[slot];
+    }
+}
+
+void OrderCache::changeOrderQty(OrderSlot slot, unsigned int qty)
+{
+    changeOrderQtyInBook(slot, qty);
+
+    const SymbolId key = partitionOf(store.security[slot], store.side[slot]);
+
+    if(security_index[key].setQty({ store.security_rung[slot], store.security_pos[slot] }, qty))
+    {
+        store.qty[slot] = qty;
+        return;
+    }
+
+    // The qty falls into another rung.
+    removeOrderFromSecurityIndex(slot);
+    store.qty[slot] = qty;
+    addOrderToSecurityIndex(slot);
+}
+
+const QtyLadder& OrderCache::partition(SymbolId security_id, Side side) const noexcept
+{
+    static const QtyLadder empty;
+
+    const SymbolId key = partitionOf(security_id, side);
+
+    return key < security_index.size() ? security_index[key] : empty;
+}
+
+void OrderCache::compactLastSlot()
+{
+    const auto from = static_cast<OrderSlot>(store.slotCount() - 1);
+    const OrderSlot to = store.removeLastSlot();
+
+    if(OrdersTableType::none == to)
+    {
+        return;
+    }
+
+    // Point the table and every index at the new slot; the positions stay the same.
+    orders_table.relocate(store.order_id[to], from, to);
+
+    security_index[partitionOf(store.security[to], store.side[to])].setSlot({ store.security_rung[to], store.security_pos[to] }, to);
+    user_index[store.user[to]][store.user_pos[to]] = to;
+    company_index[store.company[to]][store.company_pos[to]] = to;
+}
+
+std::size_t OrderCache::compactIndex(IndexType& index, std::size_t& next, std::size_t work, std::size_t& released)
+{
+    for(; work > 0 && next < index.size(); ++next)
+    {
+        IndexBucket& bucket = index[next];
+
+        if(const std::size_t capacity = bucket.capacity(); capacity > 2 * bucket.size())
+        {
+            bucket.shrink_to_fit();
+
+            released += (capacity - bucket.capacity()) * sizeof(OrderSlot);
+        }
+
+        work -= std::min(work, 1 + bucket.size());
+    }
+
+    return work;
+}
+
+void OrderCache::publishGauges() noexcept
+{
+    OrderCacheGauges gauges;
+
+    gauges.orders = store.size();
+    gauges.order_slots = store.slotCount();
+    gauges.order_id_table_capacity = orders_table.capacity();
+    gauges.order_id_bytes = store.orderIdBytes();
+
+    gauges.securities = securities.size();
+    gauges.users = users.size();
+    gauges.companies = companies.size();
+
+    counters.publish(gauges);
+}
+
+void OrderCache::finishChange()
+{
+    // The table grows on insert only; give back its room once most order ids are gone, moving
+    // the entries on a step per call so that the call crossing the threshold does not stall.
+    orders_table.shrink(order_id_shrink_step);
+
+    publishGauges();
+
+    if(!matching_size_listener || pending_notifications.empty())
+    {
+        return;
+    }
+
+    notifications.clear();
+    takeMatchingSizeChanges(notifications);
+
+    for(const MatchingSizeChange& change : notifications)
+    {
+        matching_size_listener(change);
+    }
+}
+
+void OrderCache::markChanged(SymbolId security_id)
+{
+    SecurityBook& book = security_books[security_id];
+
+    book.matching_size_dirty = true;
+
+    if(!book.changed)
+    {
+        book.changed = true;
+        changed_securities.push_back(security_id);
+    }
+
+    // Queued once however many orders of the security a call adds or removes.
+    if(book.subscribed && !book.notification_pending)
+    {
+        book.notification_pending = true;
+        pending_notifications.push_back(security_id);
+    }
+}
+
+void OrderCache::addOrderToBook(OrderSlot slot)
+{
+    const SymbolId security_id = store.security[slot];
+
+    if(security_id >= security_books.size())
+    {
+        security_books.resize(security_id + 1);
+    }
+
+    SecurityBook& book = security_books[security_id];
+    CompanyQty& company_qty = book.company_qty[store.company[slot]];
+
+    const unsigned int qty = store.qty[slot];
+
+    if(Side::Sell == store.side[slot])
+    {
+        company_qty.sell += qty;
+        book.total_sell += qty;
+    }
+    else
+    {
+        company_qty.buy += qty;
+        book.total_buy += qty;
+    }
+
+    if(!book.max_company_total_stale)
+    {
+        book.max_company_total = std::max(book.max_company_total, company_qty.total());
+    }
+
+    ++company_qty.orders;
+
+    markChanged(security_id);
+}
+
+void OrderCache::removeOrderFromBook(OrderSlot slot)
+{
+    SecurityBook& book = security_books[store.security[slot]];
+
+    const auto it_company_qty = book.company_qty.find(store.company[slot]);
+    CompanyQty& company_qty = it_company_qty->second;
+
+    const unsigned int qty = store.qty[slot];
+
+    // Losing qty of the largest company may make another company the largest.
+    if(company_qty.total() == book.max_company_total && 0 != qty)
+    {
+        book.max_company_total_stale = true;
+    }
+
+    if(Side::Sell == store.side[slot])
+    {
+        company_qty.sell -= qty;
+        book.total_sell -= qty;
+    }
+    else
+    {
+        company_qty.buy -= qty;
+        book.total_buy -= qty;
+    }
+
+    // Drop the company once its last order is gone.
+    if(0 == --company_qty.orders)
+    {
+        book.company_qty.erase(it_company_qty);
+    }
+
+    markChanged(store.security[slot]);
+}
+
+void OrderCache::changeOrderQtyInBook(OrderSlot slot, unsigned int qty)
+{
+    SecurityBook& book = security_books[store.security[slot]];
+    CompanyQty& company_qty = book.company_qty.find(store.company[slot])->second;
+
+    const unsigned int old_qty = store.qty[slot];
+
+    // As for a removal, losing qty of the largest company may make another company the largest.
+    if(qty < old_qty && company_qty.total() == book.max_company_total)
+    {
+        book.max_company_total_stale = true;
+    }
+
+    if(Side::Sell == store.side[slot])
+    {
+        company_qty.sell = company_qty.sell - old_qty + qty;
+        book.total_sell = book.total_sell - old_qty + qty;
+    }
+    else
+    {
+        company_qty.buy = company_qty.buy - old_qty + qty;
+        book.total_buy = book.total_buy - old_qty + qty;
+    }
+
+    if(!book.max_company_total_stale)
+    {
+        book.max_company_total = std::max(book.max_company_total, company_qty.total());
+    }
+
+    markChanged(store.security[slot]);
+}
+
+void OrderCache::addOrderToIndex(IndexType& index, SymbolId key, OrderSlot slot, IndexPosition position)
+{
+    if(key >= index.size())
+    {
+        index.resize(key + 1);
+    }
+
+    auto& bucket = index[key];
+
+    (store.*position)[slot] = static_cast<std::uint32_t>(bucket.size());
+    bucket.push_back(slot);
+}
+
+void OrderCache::removeOrderFromIndex(IndexType& index, SymbolId key, OrderSlot slot, IndexPosition position)
+{
+    removeOrderFromBucket(index[key], slot, position);
+}
+
+void OrderCache::removeOrderFromBucket(IndexBucket& bucket, OrderSlot slot, IndexPosition position)
+{
+    auto& positions = store.*position;
+
+    // Move the last order of the bucket into the removed order's position.
+    const std::uint32_t pos = positions[slot];
+
+    const OrderSlot last = bucket.back();
+    bucket[pos] = last;
+    positions[last] = pos;
+
+    bucket.pop_back();
 }
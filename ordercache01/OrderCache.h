@@ -1,35 +1,26 @@
 #pragma once
 
-#include "OrderCacheInterface.h"
+#include "BatchOrderCacheInterface.h"
+#include "OrderCacheStats.h"
+#include "OrderIdTable.h"
+#include "OrderStore.h"
+#include "OrderView.h"
+#include "QtyLadder.h"
+#include "SymbolTable.h"
 
-#include <unordered_set>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string_view>
+#include <type_traits>
 #include <unordered_map>
+#include <vector>
 
-// Compare orders by comparing their ids.
-struct OrderCompare
-{
-    bool operator () (const Order& o1, const Order& o2) const noexcept
-    {
-        return o1.orderId() == o2.orderId();
-    }
-};
-
-// Hash an order by hashing its id.
-struct OrderHash
-{
-    std::size_t operator () (const Order& o) const noexcept
-    {
-        return hash(o.orderId());
-    }
-
-private:
-    std::hash<std::string> hash;
-};
-
-class OrderCache : public OrderCacheInterface
+class OrderCache : public BatchOrderCacheInterface
 {
 public:
     // add order to the cache
+    // Orders with a side other than "Buy" or "Sell" are rejected and counted.
     void addOrder(Order order) override;
 
     // remove order with this unique order id from the cache
@@ -39,6 +30,8 @@ public:
     void cancelOrdersForUser(const std::string& user) override;
 
     // remove all orders in the cache for this security with qty >= minQty
+    // Takes O(log rungs + victims + orders in the rung of minQty): the rung of minQty is read in
+    // full, with SIMD. Its orders which stay have qty within an eighth below minQty, none below 16.
     void cancelOrdersForSecIdWithMinimumQty(const std::string& securityId, unsigned int minQty) override;
 
     // return the total qty that can match for the security id
@@ -47,27 +40,568 @@ public:
     // return all orders in cache in a vector
     std::vector<Order> getAllOrders() const override;
 
+    // add all orders to the cache, as if added one by one in this order
+    void addOrders(const std::vector<Order>& orders) override;
+
+    // remove the orders with these order ids from the cache
+    void cancelOrders(const std::vector<std::string_view>& orderIds) override;
+
+    // remove every order from the cache
+    // Order storage goes back to the heap a chunk at a time, not order by order. Names seen so
+    // far stay interned, and the securities which had orders are reported as changed.
+    void clear();
+
+    // Memory of the cache before and after a compaction pass, set by the call which completes it:
+    // bytes_after is memoryBytes() then, bytes_before adds back the bytes the pass gave back.
+    struct CompactProgress
+    {
+        std::size_t bytes_before = 0;
+        std::size_t bytes_after = 0;
+
+        // False while compact has more to do and is to be called again.
+        bool done = false;
+    };
+
+    // give back memory left over by removed orders, doing about work_limit orders, index
+    // entries or buckets worth of work per call and going on where the last call stopped
+    // Orders move into the slots of removed ones, empty qty rungs are dropped, and columns, index
+    // buckets and tables shrink to their contents. Orders may be added and removed between calls.
+    // Giving back the room of a single column, rung or bucket copies it in one step, charged its size.
+    CompactProgress compact(std::size_t work_limit = 4096);
+
+    // return the bytes of heap held for orders, indexes and books, in use or not
+    // Interned names are not counted. Walks every index bucket, so it is not for every call.
+    std::size_t memoryBytes() const noexcept;
+
+    // return a snapshot of the call counters, latency histograms and sizes of the cache
+    // Safe to call from any thread while the cache is in use; enabled is false unless the
+    // cache was built with ORDERCACHE_STATS.
+    OrderCacheStats stats() const noexcept { return counters.snapshot(); }
+
+    // Matching sizes of every security, at the same positions as their names.
+    // The names stay valid until the cache is loaded from a snapshot.
+    struct MatchingSizes
+    {
+        std::vector<std::string_view> security_ids;
+        std::vector<unsigned int> sizes;
+    };
+
+    // return the matching size of every security the cache has seen
+    // The securities are split in ranges across threads threads, one per hardware thread for 0.
+    MatchingSizes getMatchingSizeForAllSecurities(std::size_t threads = 0);
+
+    // return the matching size of each of the securities, at the same positions; 0 for unknown ones
+    std::vector<unsigned int> getMatchingSizeForSecurities(const std::vector<std::string>& securityIds, std::size_t threads = 0);
+
+    // return the number of orders rejected for their side
+    std::size_t rejectedOrderCount() const noexcept { return rejected_orders; }
+
+    // Open qty of a company in a security, by side.
+    struct OpenQty
+    {
+        unsigned long long buy = 0;
+        unsigned long long sell = 0;
+
+        unsigned long long total() const noexcept { return buy + sell; }
+    };
+
+    // return the open qty of the company in the security
+    // Read from the running totals of the security, without visiting orders.
+    OpenQty getOpenQtyForCompany(const std::string& company, const std::string& securityId) const;
+
+    // remove all orders in the cache for this company
+    void cancelOrdersForCompany(const std::string& company);
+
+    // remove all orders in the cache for this company and append their order ids to cancelled
+    void cancelOrdersForCompany(const std::string& company, std::vector<std::string>& cancelled);
+
+    // set the qty of the order with this order id, removing the order if qty is 0
+    // The order keeps its place in the user and company indexes, and in the security index unless
+    // the qty moves it to another rung; the aggregates of its security change by the difference.
+    void amendQty(const std::string& orderId, unsigned int qty);
+
+    // reduce the qty of the order with this order id by delta, as for a partial fill,
+    // removing the order once no qty is left
+    void reduceQty(const std::string& orderId, unsigned int delta);
+
+    // return true if an order with this order id is in the cache
+    bool containsOrder(const std::string& orderId) const;
+
+    // remove all orders in the cache for this user and append their order ids to cancelled
+    void cancelOrdersForUser(const std::string& user, std::vector<std::string>& cancelled);
+
+    // remove all orders in the cache for this security with qty >= minQty and append their order ids to cancelled
+    void cancelOrdersForSecIdWithMinimumQty(const std::string& securityId, unsigned int minQty, std::vector<std::string>& cancelled);
+
+    // append the securities whose orders changed since the last call to changed, each once
+    void takeChangedSecurities(std::vector<std::string>& changed);
+
+    // append the securities whose orders changed since the last call to changed, each once,
+    // and their matching sizes to sizes, at the same positions
+    // The sizes are not counted as getMatchingSizeForSecurity calls.
+    void takeChangedSecurities(std::vector<std::string>& changed, std::vector<unsigned int>& sizes);
+
+    // Change of the matching size of a subscribed security; securityId stays valid until the
+    // cache is loaded from a snapshot.
+    struct MatchingSizeChange
+    {
+        std::string_view securityId;
+        unsigned int previous = 0;
+        unsigned int current = 0;
+    };
+
+    using MatchingSizeListener = std::function<void(const MatchingSizeChange&)>;
+
+    // report the changes of the matching size of the security from now on
+    // The security need not have orders yet; its matching size is then 0.
+    void subscribeMatchingSize(const std::string& securityId);
+
+    // stop reporting the changes of the matching size of the security
+    void unsubscribeMatchingSize(const std::string& securityId);
+
+    // call listener with the changes at the end of every call which adds or removes orders,
+    // instead of queueing them for takeMatchingSizeChanges; an empty listener queues them again
+    // The listener runs on the thread of that call and must not add or remove orders.
+    void setMatchingSizeListener(MatchingSizeListener listener);
+
+    // append the changes queued since the last call to changes
+    // A security changed many times in between is reported once, from the size last reported
+    // to the current one, and not at all if those are the same.
+    void takeMatchingSizeChanges(std::vector<MatchingSizeChange>& changes);
+
+    // call visit(const OrderView&) for the orders in the cache, without copying them
+    // visit may return bool, false stops the walk and returns the cursor to resume it from.
+    // Return order_cursor_end when every order was visited.
+    template <typename Visit>
+    OrderCursor forEachOrder(Visit visit, OrderCursor from = 0) const;
+
+    // same as forEachOrder, for the orders of one security, user or company only,
+    // found through their index instead of a walk over every order
+    template <typename Visit>
+    OrderCursor forEachOrderForSecurity(const std::string& securityId, Visit visit, OrderCursor from = 0) const;
+
+    // same as forEachOrderForSecurity, for the orders of one side only
+    template <typename Visit>
+    OrderCursor forEachOrderForSecurity(const std::string& securityId, Side side, Visit visit, OrderCursor from = 0) const;
+
+    // call visit(const OrderView&) for the orders of the security with minQty <= qty <= maxQty
+    // Only the orders in the qty buckets at both ends of the range are filtered one by one.
+    // visit may return bool, false stops the walk.
+    template <typename Visit>
+    void forEachOrderForSecurityInQtyRange(const std::string& securityId, unsigned int minQty, unsigned int maxQty, Visit visit) const;
+
+    // return the open qty of the orders of the security with qty >= minQty
+    OpenQty getOpenQtyForSecurityWithMinimumQty(const std::string& securityId, unsigned int minQty) const;
+
+    template <typename Visit>
+    OrderCursor forEachOrderForUser(const std::string& user, Visit visit, OrderCursor from = 0) const;
+
+    template <typename Visit>
+    OrderCursor forEachOrderForCompany(const std::string& company, Visit visit, OrderCursor from = 0) const;
+
+    // write the full state of the cache to a binary snapshot file
+    // The journal position is stored along, for a journal to know which of its records the snapshot holds.
+    // Throw std::runtime_error if the file cannot be written.
+    void saveSnapshot(const std::string& path, std::uint64_t journal_position = 0) const;
+
+    // How much of a snapshot loadSnapshot checks beyond its header and the sizes it reads.
+    enum class SnapshotCheck
+    {
+        // The checksum of the file: enough for a file written by saveSnapshot, damaged or not.
+        Checksum,
+
+        // Also every reference between orders, indexes and books, in a pass over all orders:
+        // for a file which may not have been written by saveSnapshot.
+        References,
+    };
+
+    // replace the state of the cache with the one of a snapshot file written by saveSnapshot
+    // and return the journal position stored with it
+    // Throw std::runtime_error if the file cannot be read or fails the checks; the cache is left unchanged then.
+    std::uint64_t loadSnapshot(const std::string& path, SnapshotCheck check = SnapshotCheck::Checksum);
+
 private:
-    using OrdersTableType = std::unordered_set<Order, OrderHash, OrderCompare>;
-    using OrderIterator = OrdersTableType::const_iterator;
-    using IndexType = std::unordered_multimap<std::string, OrderIterator>;
+    // Open qty of a single company in a security.
+    struct CompanyQty
+    {
+        unsigned int buy = 0;
+        unsigned int sell = 0;
+
+        unsigned long long total() const noexcept { return static_cast<unsigned long long>(buy) + sell; }
+
+        // Number of orders contributing to the qty above.
+        std::size_t orders = 0;
+    };
+
+    // Keyed by company id.
+    using CompanyQtyTable = std::unordered_map<SymbolId, CompanyQty>;
+
+    // Qty aggregates of a security kept up to date by every add and cancel,
+    // so matching does not need to revisit the orders.
+    struct SecurityBook
+    {
+        CompanyQtyTable company_qty;
+
+        unsigned long long total_buy = 0;
+        unsigned long long total_sell = 0;
+
+        // The largest buy + sell qty of a single company.
+        // Marked stale when that company loses qty; recomputed by the next query.
+        unsigned long long max_company_total = 0;
+        bool max_company_total_stale = false;
+
+        // Set when the book changes; cleared when the change is taken by takeChangedSecurities.
+        bool changed = false;
+
+        // Result of the last matching query, valid until the book changes.
+        unsigned int matching_size = 0;
+        bool matching_size_dirty = true;
+
+        // Set for a subscribed security when the book changes; cleared when the change is reported.
+        bool subscribed = false;
+        bool notification_pending = false;
+
+        // The matching size last reported to subscribers.
+        unsigned int notified_size = 0;
+    };
+
+    // Indexed by security id.
+    using SecurityBooksType = std::vector<SecurityBook>;
+
+    // Order id to the slot of the order in the store.
+    using OrdersTableType = OrderIdTable;
+    using IndexBucket = std::vector<OrderSlot>;
+    // Indexed by symbol id, or by partition for the security index.
+    using IndexType = std::vector<IndexBucket>;
+    using IndexPosition = OrderStore::PositionColumn OrderStore::*;
+    using IndexKey = std::vector<SymbolId> OrderStore::*;
+
+    // Where compact goes on from: the part of the cache, then the column, ladder or bucket in it.
+    struct Compaction
+    {
+        enum class Phase
+        {
+            Store,
+            StoreColumns,
+            SecurityIndex,
+            UserIndex,
+            CompanyIndex,
+            SecurityBooks,
+            OrderIdTable,
+            OrderIds,
+        };
+
+        Phase phase = Phase::Store;
+        std::size_t next = 0;
+
+        // The rung of the ladder next in the security index phase.
+        std::size_t rung = 0;
+
+        // Bytes given back by the pass so far, less the ones taken by the order id arena it builds.
+        long long released = 0;
+    };
 
 private:
     OrdersTableType orders_table;
+    OrderStore store;
+
+    SymbolTable securities;
+    SymbolTable      users;
+    SymbolTable  companies;
 
-    IndexType security_index;
-    IndexType     user_index;
-    IndexType  company_index;
+    // The orders of a security are split by side in two partitions, see partitionOf,
+    // each ordered by qty. The handle of an order in its ladder is in security_rung and security_pos.
+    std::vector<QtyLadder> security_index;
+    IndexType                  user_index;
+    IndexType               company_index;
+
+    // Scratch mask of the orders to cancel in the rung of a minimum qty. Kept between calls to avoid allocations.
+    std::vector<std::uint64_t> victim_mask;
+
+    SecurityBooksType security_books;
+
+    // Securities with the changed flag of their book set, each once.
+    std::vector<SymbolId> changed_securities;
+
+    // Subscribed securities with the notification_pending flag of their book set, each once.
+    std::vector<SymbolId> pending_notifications;
+
+    MatchingSizeListener matching_size_listener;
+
+    // Scratch list of the changes handed to the listener.
+    std::vector<MatchingSizeChange> notifications;
+
+    std::size_t rejected_orders = 0;
+
+    Compaction compaction;
+
+    // Mutable so const methods can count their calls.
+    mutable OrderCacheCounters counters;
 
 private:
-    static void addOrderToIndex(
+    // Bulk cancels calling on_cancel(slot) for every order just before it is removed.
+    // Return the number of orders looked at.
+    template <typename OnCancel>
+    std::size_t cancelUserOrders(const std::string& user, OnCancel on_cancel);
+
+    template <typename OnCancel>
+    std::size_t cancelCompanyOrders(const std::string& company, OnCancel on_cancel);
+
+    // Cancel every order of a user or company bucket and clear it. other_index is the
+    // user or company index the bucket is not from, keyed by the other_key column.
+    template <typename OnCancel>
+    std::size_t cancelOrdersInBucket(IndexBucket& bucket, IndexType& other_index, IndexKey other_key, IndexPosition other_position, OnCancel on_cancel);
+
+    template <typename OnCancel>
+    std::size_t cancelSecurityOrdersWithMinimumQty(const std::string& securityId, unsigned int minQty, OnCancel on_cancel);
+
+    // Bring the cached matching size of every changed book up to date, in parallel.
+    void updateMatchingSizes(std::size_t threads);
+
+    // Bring the cached matching size of the book up to date and return the number of
+    // company entries looked at.
+    static std::size_t updateMatchingSize(SecurityBook& book) noexcept;
+
+    // Drop the last slot of the store, moving its order, if any, into a free slot.
+    void compactLastSlot();
+
+    // Shrink the buckets of the index from next on, until work runs out; return the work left
+    // and add the bytes given back to released.
+    static std::size_t compactIndex(IndexType& index, std::size_t& next, std::size_t work, std::size_t& released);
+
+    // Publish the sizes of the cache to the counters after a change.
+    void publishGauges() noexcept;
+
+    // Publish the gauges and hand the matching size changes to the listener, if there is one,
+    // at the end of a call which added or removed orders.
+    void finishChange();
+
+    OrderView viewOf(OrderSlot slot) const;
+
+    // Call visit on the order, return false if it asks to stop.
+    template <typename Visit>
+    static bool visitOrder(Visit& visit, const OrderView& order);
+
+    template <typename Visit>
+    OrderCursor forEachOrderInBucket(const SymbolTable& symbols, const IndexType& index, const std::string& name, Visit& visit, OrderCursor from) const;
+
+    template <typename Visit>
+    OrderCursor forEachOrderInBucket(const IndexBucket& bucket, Visit& visit, OrderCursor from) const;
+
+    // The cursor counts through the rungs of the ladder in order.
+    template <typename Visit>
+    OrderCursor forEachOrderInBucket(const QtyLadder& ladder, Visit& visit, OrderCursor from) const;
+
+    // Key of the security index partition holding the orders of a security and side.
+    static SymbolId partitionOf(SymbolId security_id, Side side) noexcept
+    {
+        return security_id * static_cast<SymbolId>(side_count) + static_cast<SymbolId>(side);
+    }
+
+    // Return the security index partition of a security and side, empty if it has none yet.
+    const QtyLadder& partition(SymbolId security_id, Side side) const noexcept;
+
+    // Put the order into the table and the store without indexing it.
+    // Return the slot of the order or none if an order with the same id is in the cache
+    // already or its side is not valid.
+    OrderSlot storeOrder(const Order& order);
+
+    void indexOrder(OrderSlot slot);
+    void removeOrder(OrderSlot slot);
+
+    void addOrderToSecurityIndex(OrderSlot slot);
+    void removeOrderFromSecurityIndex(OrderSlot slot);
+
+    // Set the qty of an order in the cache to a qty other than 0.
+    void changeOrderQty(OrderSlot slot, unsigned int qty);
+
+    static void saveIndex(SnapshotWriter& writer, const std::vector<std::vector<std::uint32_t>>& index);
+    // Read an index with a bucket for each of symbol_count names.
+    static void loadIndex(SnapshotReader& reader, std::vector<std::vector<std::uint32_t>>& index, std::size_t symbol_count);
+
+    // Throw std::runtime_error unless the orders, indexes and books loaded from a snapshot
+    // refer to the symbols and to each other the way mutations keep them.
+    void checkLoaded() const;
+
+    void markChanged(SymbolId security_id);
+
+    void addOrderToBook(OrderSlot slot);
+    void removeOrderFromBook(OrderSlot slot);
+    void changeOrderQtyInBook(OrderSlot slot, unsigned int qty);
+
+    void addOrderToIndex(
         IndexType& index,
-        const std::string& key,
-        const OrderIterator& it_order
+        SymbolId key,
+        OrderSlot slot,
+        IndexPosition position
     );
 
-    static void removeOrderFromIndex(
+    void removeOrderFromIndex(
         IndexType& index,
-        const OrderIterator& it_order
+        SymbolId key,
+        OrderSlot slot,
+        IndexPosition position
+    );
+
+    void removeOrderFromBucket(
+        IndexBucket& bucket,
+        OrderSlot slot,
+        IndexPosition position
     );
 };
+
+template <typename Visit>
+OrderCursor OrderCache::forEachOrder(Visit visit, OrderCursor from) const
+{
+    for(std::size_t slot = from; slot < store.slotCount(); ++slot)
+    {
+        if(store.isLive(static_cast<OrderSlot>(slot)) && !visitOrder(visit, viewOf(static_cast<OrderSlot>(slot))))
+        {
+            return slot + 1;
+        }
+    }
+
+    return order_cursor_end;
+}
+
+template <typename Visit>
+OrderCursor OrderCache::forEachOrderForSecurity(const std::string& securityId, Visit visit, OrderCursor from) const
+{
+    const SymbolId security_id = securities.find(securityId);
+
+    if(SymbolTable::none == security_id)
+    {
+        return order_cursor_end;
+    }
+
+    // The cursor counts through the buy partition, then the sell one.
+    const QtyLadder& buy = partition(security_id, Side::Buy);
+
+    if(from < buy.size())
+    {
+        if(const OrderCursor cursor = forEachOrderInBucket(buy, visit, from); order_cursor_end != cursor)
+        {
+            return cursor;
+        }
+
+        from = buy.size();
+    }
+
+    const OrderCursor cursor = forEachOrderInBucket(partition(security_id, Side::Sell), visit, from - buy.size());
+
+    return order_cursor_end != cursor ? buy.size() + cursor : cursor;
+}
+
+template <typename Visit>
+OrderCursor OrderCache::forEachOrderForSecurity(const std::string& securityId, Side side, Visit visit, OrderCursor from) const
+{
+    const SymbolId security_id = securities.find(securityId);
+
+    if(SymbolTable::none == security_id)
+    {
+        return order_cursor_end;
+    }
+
+    return forEachOrderInBucket(partition(security_id, side), visit, from);
+}
+
+template <typename Visit>
+void OrderCache::forEachOrderForSecurityInQtyRange(const std::string& securityId, unsigned int minQty, unsigned int maxQty, Visit visit) const
+{
+    const SymbolId security_id = securities.find(securityId);
+
+    if(SymbolTable::none == security_id || minQty > maxQty)
+    {
+        return;
+    }
+
+    for(const Side side : { Side::Buy, Side::Sell })
+    {
+        const bool completed = partition(security_id, side).forEachInRange(minQty, maxQty, [&](OrderSlot slot)
+        {
+            return visitOrder(visit, viewOf(slot));
+        });
+
+        if(!completed)
+        {
+            return;
+        }
+    }
+}
+
+template <typename Visit>
+OrderCursor OrderCache::forEachOrderForUser(const std::string& user, Visit visit, OrderCursor from) const
+{
+    return forEachOrderInBucket(users, user_index, user, visit, from);
+}
+
+template <typename Visit>
+OrderCursor OrderCache::forEachOrderForCompany(const std::string& company, Visit visit, OrderCursor from) const
+{
+    return forEachOrderInBucket(companies, company_index, company, visit, from);
+}
+
+template <typename Visit>
+bool OrderCache::visitOrder(Visit& visit, const OrderView& order)
+{
+    if constexpr(std::is_void_v<std::invoke_result_t<Visit&, const OrderView&>>)
+    {
+        visit(order);
+        return true;
+    }
+    else
+    {
+        return visit(order);
+    }
+}
+
+template <typename Visit>
+OrderCursor OrderCache::forEachOrderInBucket(const SymbolTable& symbols, const IndexType& index, const std::string& name, Visit& visit, OrderCursor from) const
+{
+    const SymbolId id = symbols.find(name);
+
+    if(SymbolTable::none == id || id >= index.size())
+    {
+        return order_cursor_end;
+    }
+
+    return forEachOrderInBucket(index[id], visit, from);
+}
+
+template <typename Visit>
+OrderCursor OrderCache::forEachOrderInBucket(const IndexBucket& bucket, Visit& visit, OrderCursor from) const
+{
+    for(std::size_t position = from; position < bucket.size(); ++position)
+    {
+        if(!visitOrder(visit, viewOf(bucket[position])))
+        {
+            return position + 1;
+        }
+    }
+
+    return order_cursor_end;
+}
+
+template <typename Visit>
+OrderCursor OrderCache::forEachOrderInBucket(const QtyLadder& ladder, Visit& visit, OrderCursor from) const
+{
+    // Cursor of the first order of the rung.
+    std::size_t first = 0;
+
+    for(std::size_t rank = 0; rank < ladder.rungCount(); ++rank)
+    {
+        const QtyLadder::Rung& rung = ladder.rungByQty(rank);
+
+        for(std::size_t position = from > first ? from - first : 0; position < rung.size(); ++position)
+        {
+            if(!visitOrder(visit, viewOf(rung.slots[position])))
+            {
+                return first + position + 1;
+            }
+        }
+
+        first += rung.size();
+    }
+
+    return order_cursor_end;
+}
@@ -0,0 +1,170 @@
+#include "OrderCacheStats.h"
+#include "Bits.h"
+
+#include <algorithm>
+#include <cmath>
+
+const char* methodName(CacheMethod method) noexcept
+{
+    switch(method)
+    {
+    case CacheMethod::AddOrder: return "addOrder";
+    case CacheMethod::CancelOrder: return "cancelOrder";
+    case CacheMethod::CancelOrdersForUser: return "cancelOrdersForUser";
+    case CacheMethod::CancelOrdersForSecIdWithMinimumQty: return "cancelOrdersForSecIdWithMinimumQty";
+    case CacheMethod::GetMatchingSizeForSecurity: return "getMatchingSizeForSecurity";
+    case CacheMethod::GetAllOrders: return "getAllOrders";
+    case CacheMethod::CancelOrdersForCompany: return "cancelOrdersForCompany";
+    }
+
+    return "unknown";
+}
+
+std::size_t LatencyHistogram::bucketOf(std::uint64_t ns) noexcept
+{
+    if(ns < sub_buckets)
+    {
+        return static_cast<std::size_t>(ns);
+    }
+
+    // The power of two of the value picks the bucket group, the next 3 bits the bucket in it.
+    const std::size_t exponent = highestSetBit(ns);
+    const std::size_t sub_bucket = static_cast<std::size_t>(ns >> (exponent - 3)) & (sub_buckets - 1);
+
+    return (exponent - 2) * sub_buckets + sub_bucket;
+}
+
+std::uint64_t LatencyHistogram::bucketUpperBound(std::size_t bucket) noexcept
+{
+    if(bucket < sub_buckets)
+    {
+        return bucket;
+    }
+
+    const int shift = static_cast<int>(bucket / sub_buckets) - 1;
+    const std::uint64_t lower = static_cast<std::uint64_t>(sub_buckets + bucket % sub_buckets) << shift;
+
+    return lower + ((std::uint64_t{ 1 } << shift) - 1);
+}
+
+std::uint64_t LatencyHistogram::count() const noexcept
+{
+    std::uint64_t total = 0;
+
+    for(const std::uint64_t c : counts)
+    {
+        total += c;
+    }
+
+    return total;
+}
+
+std::uint64_t LatencyHistogram::percentile(double q) const noexcept
+{
+    const std::uint64_t total = count();
+
+    if(0 == total)
+    {
+        return 0;
+    }
+
+    // The rank of the quantile, counting from 1.
+    const auto rank = std::max<std::uint64_t>(1, static_cast<std::uint64_t>(std::ceil(q * static_cast<double>(total))));
+
+    std::uint64_t seen = 0;
+
+    for(std::size_t bucket = 0; bucket < bucket_count; ++bucket)
+    {
+        seen += counts[bucket];
+
+        if(seen >= rank)
+        {
+            return bucketUpperBound(bucket);
+        }
+    }
+
+    return bucketUpperBound(bucket_count - 1);
+}
+
+#ifdef ORDERCACHE_STATS
+
+namespace
+{
+    // Single writer: a relaxed load and store, where fetch_add would lock the bus.
+    void bump(std::atomic<std::uint64_t>& counter, std::uint64_t by) noexcept
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + by, std::memory_order_relaxed);
+    }
+
+    void set(std::atomic<std::uint64_t>& gauge, std::size_t value) noexcept
+    {
+        gauge.store(static_cast<std::uint64_t>(value), std::memory_order_relaxed);
+    }
+
+    std::uint64_t get(const std::atomic<std::uint64_t>& value) noexcept
+    {
+        return value.load(std::memory_order_relaxed);
+    }
+}
+
+void OrderCacheCounters::record(CacheMethod method, std::chrono::steady_clock::duration elapsed, std::size_t scanned) noexcept
+{
+    Method& counters = methods[static_cast<std::size_t>(method)];
+
+    const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+
+    bump(counters.calls, 1);
+    bump(counters.scanned, scanned);
+    bump(counters.latency[LatencyHistogram::bucketOf(ns > 0 ? static_cast<std::uint64_t>(ns) : 0)], 1);
+}
+
+void OrderCacheCounters::publish(const OrderCacheGauges& gauges) noexcept
+{
+    set(orders, gauges.orders);
+    set(order_slots, gauges.order_slots);
+    set(order_id_table_capacity, gauges.order_id_table_capacity);
+    set(order_id_bytes, gauges.order_id_bytes);
+
+    set(securities, gauges.securities);
+    set(users, gauges.users);
+    set(companies, gauges.companies);
+}
+
+void OrderCacheCounters::matchingSizeCached(bool hit) noexcept
+{
+    bump(hit ? matching_size_hits : matching_size_misses, 1);
+}
+
+OrderCacheStats OrderCacheCounters::snapshot() const noexcept
+{
+    OrderCacheStats stats;
+
+    stats.enabled = true;
+
+    for(std::size_t m = 0; m < cache_method_count; ++m)
+    {
+        stats.methods[m].calls = get(methods[m].calls);
+        stats.methods[m].scanned = get(methods[m].scanned);
+
+        for(std::size_t bucket = 0; bucket < LatencyHistogram::bucket_count; ++bucket)
+        {
+            stats.methods[m].latency.counts[bucket] = get(methods[m].latency[bucket]);
+        }
+    }
+
+    stats.matching_size_hits = get(matching_size_hits);
+    stats.matching_size_misses = get(matching_size_misses);
+
+    stats.orders = get(orders);
+    stats.order_slots = get(order_slots);
+    stats.order_id_table_capacity = get(order_id_table_capacity);
+    stats.order_id_bytes = get(order_id_bytes);
+
+    stats.securities = get(securities);
+    stats.users = get(users);
+    stats.companies = get(companies);
+
+    return stats;
+}
+
+#endif
@@ -0,0 +1,208 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+/*
+   Instrumentation of OrderCache, built in when ORDERCACHE_STATS is defined.
+   Without it OrderCacheCounters is an empty class whose calls compile to nothing, and
+   OrderCache::stats returns a snapshot with enabled set to false.
+*/
+
+// The methods of OrderCacheInterface, in declaration order, then the counted OrderCache extensions.
+enum class CacheMethod : std::size_t
+{
+    AddOrder,
+    CancelOrder,
+    CancelOrdersForUser,
+    CancelOrdersForSecIdWithMinimumQty,
+    GetMatchingSizeForSecurity,
+    GetAllOrders,
+    CancelOrdersForCompany,
+};
+
+constexpr std::size_t cache_method_count = 7;
+
+// return the name of the method as declared in OrderCacheInterface or OrderCache
+const char* methodName(CacheMethod method) noexcept;
+
+// Latency histogram with HDR-style log-linear buckets: values below 8 ns get a bucket each, and
+// every power of two above is split in 8 buckets, so a bucket bound is within 12.5% of its values.
+struct LatencyHistogram
+{
+    static constexpr std::size_t sub_buckets = 8;
+    static constexpr std::size_t bucket_count = 62 * sub_buckets;
+
+    // return the bucket of a latency in ns
+    static std::size_t bucketOf(std::uint64_t ns) noexcept;
+
+    // return the largest latency in ns that falls into the bucket
+    static std::uint64_t bucketUpperBound(std::size_t bucket) noexcept;
+
+    // return the number of latencies recorded
+    std::uint64_t count() const noexcept;
+
+    // return the upper bound in ns of the bucket holding the q-quantile, 0 <= q <= 1; 0 if empty
+    std::uint64_t percentile(double q) const noexcept;
+
+    std::array<std::uint64_t, bucket_count> counts{};
+};
+
+// Counters of one counted method.
+struct MethodStats
+{
+    std::uint64_t calls = 0;
+
+    // Orders, or book entries for getMatchingSizeForSecurity, the calls went through.
+    std::uint64_t scanned = 0;
+
+    LatencyHistogram latency;
+};
+
+// A snapshot of the instrumentation of a cache.
+struct OrderCacheStats
+{
+    // False when the cache was built without ORDERCACHE_STATS; everything else is 0 then.
+    bool enabled = false;
+
+    std::array<MethodStats, cache_method_count> methods{};
+
+    // getMatchingSizeForSecurity calls answered from the result cached for the security,
+    // and calls on a security changed since its last query.
+    std::uint64_t matching_size_hits = 0;
+    std::uint64_t matching_size_misses = 0;
+
+    std::uint64_t orders = 0;
+    std::uint64_t order_slots = 0;
+    std::uint64_t order_id_table_capacity = 0;
+    std::uint64_t order_id_bytes = 0;
+
+    std::uint64_t securities = 0;
+    std::uint64_t users = 0;
+    std::uint64_t companies = 0;
+
+    const MethodStats& operator [] (CacheMethod method) const noexcept { return methods[static_cast<std::size_t>(method)]; }
+
+    // return the share of the order id table in use
+    double orderIdTableLoadFactor() const noexcept
+    {
+        return order_id_table_capacity ? static_cast<double>(orders) / static_cast<double>(order_id_table_capacity) : 0.0;
+    }
+
+    // return the share of order slots holding an order
+    double orderSlotLoadFactor() const noexcept
+    {
+        return order_slots ? static_cast<double>(orders) / static_cast<double>(order_slots) : 0.0;
+    }
+};
+
+// Sizes of the cache published with every mutation.
+struct OrderCacheGauges
+{
+    std::size_t orders = 0;
+    std::size_t order_slots = 0;
+    std::size_t order_id_table_capacity = 0;
+    std::size_t order_id_bytes = 0;
+
+    std::size_t securities = 0;
+    std::size_t users = 0;
+    std::size_t companies = 0;
+};
+
+#ifdef ORDERCACHE_STATS
+
+// Live counters of a cache. The cache thread is their only writer, so they are updated with
+// plain relaxed loads and stores, without locked instructions; snapshot reads them from any
+// thread without stalling the writer, each value on its own.
+// The counters stay with the cache object: moving a cache into another does not move them.
+class OrderCacheCounters
+{
+public:
+    // Times one call of a method, recorded when it goes out of scope.
+    class Call
+    {
+    public:
+        Call(OrderCacheCounters& counters, CacheMethod method) noexcept :
+            counters{ counters },
+            method{ method },
+            start{ std::chrono::steady_clock::now() }
+        {
+        }
+
+        ~Call() { counters.record(method, std::chrono::steady_clock::now() - start, scanned_count); }
+
+        Call(const Call&) = delete;
+        Call& operator = (const Call&) = delete;
+
+        // add to the number of orders the call went through
+        void scanned(std::size_t count) noexcept { scanned_count += count; }
+
+    private:
+        OrderCacheCounters& counters;
+        const CacheMethod method;
+        const std::chrono::steady_clock::time_point start;
+        std::size_t scanned_count = 0;
+    };
+
+    OrderCacheCounters() = default;
+
+    OrderCacheCounters(OrderCacheCounters&&) noexcept {}
+    OrderCacheCounters& operator = (OrderCacheCounters&&) noexcept { return *this; }
+
+    void publish(const OrderCacheGauges& gauges) noexcept;
+
+    // count a matching query answered from the cached result, or not
+    void matchingSizeCached(bool hit) noexcept;
+
+    OrderCacheStats snapshot() const noexcept;
+
+private:
+    struct Method
+    {
+        std::atomic<std::uint64_t> calls{ 0 };
+        std::atomic<std::uint64_t> scanned{ 0 };
+        std::array<std::atomic<std::uint64_t>, LatencyHistogram::bucket_count> latency{};
+    };
+
+    void record(CacheMethod method, std::chrono::steady_clock::duration elapsed, std::size_t scanned) noexcept;
+
+    std::array<Method, cache_method_count> methods;
+
+    std::atomic<std::uint64_t> matching_size_hits{ 0 };
+    std::atomic<std::uint64_t> matching_size_misses{ 0 };
+
+    std::atomic<std::uint64_t> orders{ 0 };
+    std::atomic<std::uint64_t> order_slots{ 0 };
+    std::atomic<std::uint64_t> order_id_table_capacity{ 0 };
+    std::atomic<std::uint64_t> order_id_bytes{ 0 };
+
+    std::atomic<std::uint64_t> securities{ 0 };
+    std::atomic<std::uint64_t> users{ 0 };
+    std::atomic<std::uint64_t> companies{ 0 };
+};
+
+#else
+
+// Compiled out: every call is an empty inline function.
+class OrderCacheCounters
+{
+public:
+    class Call
+    {
+    public:
+        Call(OrderCacheCounters&, CacheMethod) noexcept {}
+
+        void scanned(std::size_t) noexcept {}
+    };
+
+    void publish(const OrderCacheGauges&) noexcept {}
+
+    void matchingSizeCached(bool) noexcept {}
+
+    OrderCacheStats snapshot() const noexcept { return {}; }
+};
+
+#endif
@@ -0,0 +1,208 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "OrderCache.h"
+
+TEST(OrderCacheStatsTest, BucketsLatenciesWithinAnEighth)
+{
+    for(std::uint64_t ns : { 0ull, 1ull, 7ull, 8ull, 9ull, 15ull, 16ull, 100ull, 1000ull, 123456789ull, 1ull << 40 })
+    {
+        const std::size_t bucket = LatencyHistogram::bucketOf(ns);
+
+        ASSERT_LT(bucket, LatencyHistogram::bucket_count);
+        EXPECT_GE(LatencyHistogram::bucketUpperBound(bucket), ns);
+        EXPECT_LE(LatencyHistogram::bucketUpperBound(bucket), ns + ns / 8) << ns;
+
+        if(bucket > 0)
+        {
+            EXPECT_LT(LatencyHistogram::bucketUpperBound(bucket - 1), ns);
+        }
+    }
+
+    EXPECT_EQ(LatencyHistogram::bucketOf(~0ull), LatencyHistogram::bucket_count - 1);
+}
+
+TEST(OrderCacheStatsTest, FindsPercentiles)
+{
+    LatencyHistogram histogram;
+
+    for(std::uint64_t ns = 1; ns <= 1000; ++ns)
+    {
+        ++histogram.counts[LatencyHistogram::bucketOf(ns)];
+    }
+
+    EXPECT_EQ(histogram.count(), 1000u);
+    EXPECT_EQ(histogram.percentile(0.0), 1u);
+    EXPECT_NEAR(static_cast<double>(histogram.percentile(0.5)), 500.0, 500.0 / 8);
+    EXPECT_NEAR(static_cast<double>(histogram.percentile(0.99)), 990.0, 990.0 / 8);
+    EXPECT_EQ(histogram.percentile(1.0), LatencyHistogram::bucketUpperBound(LatencyHistogram::bucketOf(1000)));
+    EXPECT_EQ(LatencyHistogram{}.percentile(0.5), 0u);
+}
+
+TEST(OrderCacheStatsTest, CountsCallsAndScannedOrders)
+{
+    OrderCache cache;
+
+#ifdef ORDERCACHE_STATS
+    for(int i = 0; i < 100; ++i)
+    {
+        cache.addOrder({ "o" + std::to_string(i), "s" + std::to_string(i % 2), i % 2 ? "Buy" : "Sell",
+            static_cast<unsigned int>(i), "u" + std::to_string(i % 4), "c" + std::to_string(i % 5) });
+    }
+
+    cache.addOrder({ "o1", "s1", "Buy", 100, "u1", "c1" });
+    cache.cancelOrder("o0");
+    cache.cancelOrder("unknown");
+    cache.cancelOrdersForUser("u1");
+    cache.cancelOrdersForSecIdWithMinimumQty("s0", 50);
+    cache.getMatchingSizeForSecurity("s0");
+    cache.getMatchingSizeForSecurity("s0");
+    cache.getAllOrders();
+
+    const OrderCacheStats stats = cache.stats();
+
+    ASSERT_TRUE(stats.enabled);
+
+    EXPECT_EQ(stats[CacheMethod::AddOrder].calls, 101u);
+    EXPECT_EQ(stats[CacheMethod::AddOrder].latency.count(), 101u);
+    EXPECT_EQ(stats[CacheMethod::CancelOrder].calls, 2u);
+    EXPECT_EQ(stats[CacheMethod::CancelOrdersForUser].calls, 1u);
+    EXPECT_EQ(stats[CacheMethod::CancelOrdersForSecIdWithMinimumQty].calls, 1u);
+    EXPECT_EQ(stats[CacheMethod::GetMatchingSizeForSecurity].calls, 2u);
+    EXPECT_EQ(stats[CacheMethod::GetAllOrders].calls, 1u);
+
+    // u1 had 25 orders, all in s1; s0 had 49 left after o0, 25 of them with qty >= 50.
+    // The qty bucket of 50 holds 48 to 55, so the min-qty cancel looks at 48 besides its victims.
+    EXPECT_EQ(stats[CacheMethod::CancelOrdersForUser].scanned, 25u);
+    EXPECT_EQ(stats[CacheMethod::CancelOrdersForSecIdWithMinimumQty].scanned, 26u);
+
+    const std::uint64_t orders = 100 - 1 - 25 - 25;
+
+    EXPECT_EQ(stats[CacheMethod::GetAllOrders].scanned, orders);
+    EXPECT_EQ(stats.orders, orders);
+    EXPECT_EQ(stats.order_slots, 100u);
+    EXPECT_EQ(stats.securities, 2u);
+    EXPECT_EQ(stats.users, 4u);
+    EXPECT_EQ(stats.companies, 5u);
+    EXPECT_GE(stats.order_id_table_capacity, stats.orders);
+    EXPECT_GT(stats.orderIdTableLoadFactor(), 0.0);
+    EXPECT_LE(stats.orderIdTableLoadFactor(), 7.0 / 8);
+    EXPECT_DOUBLE_EQ(stats.orderSlotLoadFactor(), static_cast<double>(orders) / 100);
+#else
+    cache.addOrder({ "o1", "s1", "Buy", 100, "u1", "c1" });
+
+    EXPECT_FALSE(cache.stats().enabled);
+    EXPECT_EQ(cache.stats()[CacheMethod::AddOrder].calls, 0u);
+#endif
+}
+
+TEST(OrderCacheStatsTest, ReadsStatsWhileTheCacheChanges)
+{
+    OrderCache cache;
+    std::atomic<bool> done{ false };
+
+    std::thread scraper{ [&]
+    {
+        std::uint64_t last_calls = 0;
+
+        while(!done)
+        {
+            const std::uint64_t calls = cache.stats()[CacheMethod::AddOrder].calls;
+
+            EXPECT_GE(calls, last_calls);
+            last_calls = calls;
+        }
+    } };
+
+    for(int i = 0; i < 20000; ++i)
+    {
+        cache.addOrder({ "o" + std::to_string(i), "s1", "Buy", 100, "u1", "c1" });
+        cache.cancelOrder("o" + std::to_string(i - 10));
+    }
+
+    done = true;
+    scraper.join();
+
+#ifdef ORDERCACHE_STATS
+    EXPECT_EQ(cache.stats()[CacheMethod::AddOrder].calls, 20000u);
+#endif
+}
+
+TEST(OrderCacheStatsTest, CountsBulkCancelsReturningOrderIds)
+{
+    OrderCache cache;
+
+    for(int i = 0; i < 40; ++i)
+    {
+        cache.addOrder({ "o" + std::to_string(i), "s" + std::to_string(i % 2), i % 2 ? "Buy" : "Sell",
+            static_cast<unsigned int>(100 + i), "u" + std::to_string(i % 4), "c" + std::to_string(i % 5) });
+    }
+
+    std::vector<std::string> cancelled;
+    std::vector<std::string> changed;
+    std::vector<unsigned int> sizes;
+
+    cache.cancelOrdersForUser("u1", cancelled);
+    cache.cancelOrdersForSecIdWithMinimumQty("s0", 130, cancelled);
+    cache.cancelOrdersForCompany("c2");
+    cache.cancelOrdersForCompany("c3", cancelled);
+    cache.takeChangedSecurities(changed, sizes);
+
+    EXPECT_EQ(changed.size(), 2u);
+    EXPECT_EQ(sizes.size(), 2u);
+
+#ifdef ORDERCACHE_STATS
+    const OrderCacheStats stats = cache.stats();
+
+    EXPECT_EQ(stats[CacheMethod::CancelOrdersForUser].calls, 1u);
+    EXPECT_EQ(stats[CacheMethod::CancelOrdersForSecIdWithMinimumQty].calls, 1u);
+    EXPECT_EQ(stats[CacheMethod::CancelOrdersForCompany].calls, 2u);
+    EXPECT_EQ(stats[CacheMethod::CancelOrdersForUser].scanned, 10u);
+
+    // Matching sizes taken with the changes are not queries.
+    EXPECT_EQ(stats[CacheMethod::GetMatchingSizeForSecurity].calls, 0u);
+#endif
+}
+
+TEST(OrderCacheStatsTest, AnswersRepeatedMatchingQueriesFromCache)
+{
+    OrderCache cache;
+
+    cache.addOrder({ "o1", "s1", "Buy", 100, "u1", "c1" });
+    cache.addOrder({ "o2", "s1", "Sell", 300, "u2", "c2" });
+    cache.addOrder({ "o3", "s2", "Sell", 300, "u2", "c2" });
+
+    EXPECT_EQ(cache.getMatchingSizeForSecurity("s1"), 100u);
+    EXPECT_EQ(cache.getMatchingSizeForSecurity("s1"), 100u);
+
+    // A change to another security keeps the result.
+    cache.addOrder({ "o4", "s2", "Buy", 50, "u1", "c1" });
+    EXPECT_EQ(cache.getMatchingSizeForSecurity("s1"), 100u);
+
+    // Every kind of change to the security drops it.
+    cache.addOrder({ "o5", "s1", "Buy", 100, "u3", "c3" });
+    EXPECT_EQ(cache.getMatchingSizeForSecurity("s1"), 200u);
+
+    cache.cancelOrder("o1");
+    EXPECT_EQ(cache.getMatchingSizeForSecurity("s1"), 100u);
+
+    cache.cancelOrdersForSecIdWithMinimumQty("s1", 200);
+    EXPECT_EQ(cache.getMatchingSizeForSecurity("s1"), 0u);
+
+    cache.addOrder({ "o6", "s1", "Sell", 100, "u1", "c1" });
+    EXPECT_EQ(cache.getMatchingSizeForSecurity("s1"), 100u);
+
+    cache.cancelOrdersForUser("u1");
+    EXPECT_EQ(cache.getMatchingSizeForSecurity("s1"), 0u);
+
+#ifdef ORDERCACHE_STATS
+    const OrderCacheStats stats = cache.stats();
+
+    EXPECT_EQ(stats.matching_size_hits, 2u);
+    EXPECT_EQ(stats.matching_size_misses, 6u);
+#endif
+}
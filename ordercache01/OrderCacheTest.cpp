@@ -1,8 +1,19 @@
 #include <gtest/gtest.h>
 #include <ostream>
 #include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <map>
+#include <random>
+#include <stdexcept>
+#include <string>
 
 #include "OrderCache.h"
+#include "Snapshot.h"
 
 std::ostream& operator << (std::ostream& os, const Order& o)
 {
@@ -180,6 +191,68 @@ TEST(OrderCacheTest, CancelsSecurityOrdersWithMinQty)
     EXPECT_EQ(expected_orders, returned_orders);
 }
 
+TEST(OrderCacheTest, CancelsSecurityOrdersWithMinQtyInLargeBook)
+{
+    OrderCache cache;
+
+    for(int i = 0; i < 1000; ++i)
+    {
+        cache.addOrder({ "o" + std::to_string(i), i % 3 ? "s1" : "s2", i % 2 ? "Buy" : "Sell", static_cast<unsigned int>(i * 7919 % 1000), "u" + std::to_string(i % 5), "c" + std::to_string(i % 4) });
+    }
+
+    cache.cancelOrdersForSecIdWithMinimumQty("s1", 500);
+
+    std::size_t s1_orders = 0;
+
+    for(const auto& order : cache.getAllOrders())
+    {
+        if(order.securityId() == "s1")
+        {
+            EXPECT_LT(order.qty(), 500u);
+            ++s1_orders;
+        }
+    }
+
+    std::size_t expected_s1_orders = 0;
+
+    for(int i = 0; i < 1000; ++i)
+    {
+        expected_s1_orders += (i % 3 && i * 7919 % 1000 < 500) ? 1 : 0;
+    }
+
+    EXPECT_EQ(s1_orders, expected_s1_orders);
+    EXPECT_EQ(cache.getAllOrders().size(), expected_s1_orders + 334);
+}
+
+TEST(OrderCacheTest, CancelsSecurityOrdersWithMinQtyInOneLargeRung)
+{
+    OrderCache cache;
+
+    // Every qty in [1024, 1152) shares a rung, so the victims are picked out of one rung of many mask words.
+    for(int i = 0; i < 1000; ++i)
+    {
+        cache.addOrder({ "o" + std::to_string(i), "s1", i % 2 ? "Buy" : "Sell", 1024 + static_cast<unsigned int>(i * 37 % 128), "u1", "c" + std::to_string(i % 4) });
+    }
+
+    cache.cancelOrdersForSecIdWithMinimumQty("s1", 1100);
+
+    std::size_t expected_orders = 0;
+
+    for(int i = 0; i < 1000; ++i)
+    {
+        expected_orders += 1024 + i * 37 % 128 < 1100 ? 1 : 0;
+    }
+
+    const std::vector<Order> orders = cache.getAllOrders();
+
+    EXPECT_EQ(orders.size(), expected_orders);
+
+    for(const auto& order : orders)
+    {
+        EXPECT_LT(order.qty(), 1100u);
+    }
+}
+
 TEST(OrderCacheTest, MatchesOrders)
 {
     const std::vector<Order> added_orders{
@@ -335,6 +408,207 @@ TEST(OrderCacheTest, MatchesOrders07)
     EXPECT_EQ(matched_amount, 2700);
 }
 
+TEST(OrderCacheTest, MatchesOrders08)
+{
+    // Matching "a" with "d" first would leave most of "b" unmatched.
+    const std::vector<Order> added_orders{
+        {"o1", "s1", "Sell",  3, "u1", "a"},
+        {"o2", "s1", "Buy" , 10, "u1", "b"},
+        {"o3", "s1", "Sell", 10, "u1", "b"},
+        {"o4", "s1", "Buy" ,  4, "u1", "d"},
+    };
+
+    OrderCache cache;
+
+    for(const auto& order : added_orders)
+    {
+        cache.addOrder(order);
+    }
+
+    const auto matched_amount = cache.getMatchingSizeForSecurity("s1");
+
+    EXPECT_EQ(matched_amount, 7);
+}
+
+TEST(OrderCacheTest, MatchesOrdersAfterCancels)
+{
+    const std::vector<Order> added_orders{
+        {"OrdId1", "SecId1", "Buy" , 1000, "User1", "CompanyA"},
+        {"OrdId2", "SecId2", "Sell", 3000, "User2", "CompanyB"},
+        {"OrdId3", "SecId1", "Sell",  500, "User3", "CompanyA"},
+        {"OrdId4", "SecId2", "Buy" ,  600, "User4", "CompanyC"},
+        {"OrdId5", "SecId2", "Buy" ,  100, "User5", "CompanyB"},
+        {"OrdId6", "SecId3", "Buy" , 1000, "User6", "CompanyD"},
+        {"OrdId7", "SecId2", "Buy" , 2000, "User7", "CompanyE"},
+        {"OrdId8", "SecId2", "Sell", 5000, "User8", "CompanyE"},
+    };
+
+    OrderCache cache;
+
+    for(const auto& order : added_orders)
+    {
+        cache.addOrder(order);
+    }
+
+    cache.cancelOrder("OrdId4");
+    EXPECT_EQ(cache.getMatchingSizeForSecurity("SecId2"), 2100);
+
+    cache.cancelOrdersForUser("User7");
+    EXPECT_EQ(cache.getMatchingSizeForSecurity("SecId2"), 100);
+
+    cache.cancelOrdersForSecIdWithMinimumQty("SecId2", 4000);
+    EXPECT_EQ(cache.getMatchingSizeForSecurity("SecId2"), 0);
+
+    cache.addOrder({ "OrdId9", "SecId2", "Buy", 700, "User9", "CompanyC" });
+    EXPECT_EQ(cache.getMatchingSizeForSecurity("SecId2"), 700);
+
+    EXPECT_EQ(cache.getMatchingSizeForSecurity("SecId1"), 0);
+    EXPECT_EQ(cache.getMatchingSizeForSecurity("SecId9"), 0);
+}
+
+// Reference matching size: max flow from sell qty to buy qty of other companies,
+// found with unit augmenting paths. Only fit for small books.
+static unsigned int referenceMatchingSize(const std::vector<Order>& orders, const std::string& securityId)
+{
+    std::map<std::string, unsigned int> sell_qty;
+    std::map<std::string, unsigned int> buy_qty;
+
+    for(const auto& order : orders)
+    {
+        if(order.securityId() == securityId)
+        {
+            (order.side() == "Sell" ? sell_qty : buy_qty)[order.company()] += order.qty();
+        }
+    }
+
+    // flow[sell company][buy company]
+    std::map<std::string, std::map<std::string, unsigned int>> flow;
+    std::map<std::string, bool> visited_buy;
+
+    // Find a path pushing one more unit from sell company `seller`, possibly rerouting existing flow.
+    std::function<bool(const std::string&)> augment = [&](const std::string& seller) -> bool
+    {
+        for(auto& [buyer, remaining] : buy_qty)
+        {
+            if(buyer == seller || visited_buy[buyer])
+            {
+                continue;
+            }
+
+            visited_buy[buyer] = true;
+
+            if(remaining > 0)
+            {
+                --remaining;
+                ++flow[seller][buyer];
+                return true;
+            }
+
+            for(auto& [other_seller, flows] : flow)
+            {
+                if(flows[buyer] > 0 && augment(other_seller))
+                {
+                    --flows[buyer];
+                    ++flow[seller][buyer];
+                    return true;
+                }
+            }
+        }
+
+        return false;
+    };
+
+    unsigned int matched_qty = 0;
+
+    for(auto& [seller, qty] : sell_qty)
+    {
+        for(unsigned int unit = 0; unit < qty; ++unit)
+        {
+            visited_buy.clear();
+
+            if(!augment(seller))
+            {
+                break;
+            }
+
+            ++matched_qty;
+        }
+    }
+
+    return matched_qty;
+}
+
+TEST(OrderCacheTest, MatchesOrdersLikeReferenceOnRandomBooks)
+{
+    std::mt19937 rng{ 20240101 };
+    std::uniform_int_distribution<int> company_dist{ 0, 4 };
+    std::uniform_int_distribution<int> qty_dist{ 0, 12 };
+    std::uniform_int_distribution<int> count_dist{ 1, 12 };
+
+    for(int book = 0; book < 300; ++book)
+    {
+        OrderCache cache;
+        std::vector<Order> orders;
+
+        const int count = count_dist(rng);
+
+        for(int i = 0; i < count; ++i)
+        {
+            orders.push_back({ "o" + std::to_string(i), "s1", rng() % 2 ? "Buy" : "Sell", static_cast<unsigned int>(qty_dist(rng)),
+                "u" + std::to_string(i % 3), "c" + std::to_string(company_dist(rng)) });
+
+            cache.addOrder(orders.back());
+        }
+
+        EXPECT_EQ(cache.getMatchingSizeForSecurity("s1"), referenceMatchingSize(orders, "s1"));
+
+        // Cancel a user and check again, so the incrementally maintained book is covered too.
+        cache.cancelOrdersForUser("u0");
+
+        orders.erase(std::remove_if(std::begin(orders), std::end(orders), [](const Order& o) { return o.user() == "u0"; }), std::end(orders));
+
+        EXPECT_EQ(cache.getMatchingSizeForSecurity("s1"), referenceMatchingSize(orders, "s1"));
+    }
+}
+
+TEST(OrderCacheTest, ReturnsOrdersAddedAfterCancels)
+{
+    OrderCache cache;
+
+    cache.addOrder({ "o1", "s1", "Sell", 100, "u1", "c1" });
+    cache.addOrder({ "o2", "s2", "Buy" , 200, "u2", "c2" });
+    cache.addOrder({ "o3", "s1", "Buy" , 300, "u1", "c2" });
+
+    cache.cancelOrdersForUser("u1");
+
+    cache.addOrder({ "o4", "s3", "Sell", 400, "u3", "c3" });
+    cache.addOrder({ "o5", "s1", "Sell", 500, "u2", "c1" });
+    cache.addOrder({ "o6", "s1", "Buy" , 600, "u1", "c2" });
+
+    const std::vector<Order> expected_orders{
+        {"o2", "s2", "Buy" , 200, "u2", "c2"},
+        {"o4", "s3", "Sell", 400, "u3", "c3"},
+        {"o5", "s1", "Sell", 500, "u2", "c1"},
+        {"o6", "s1", "Buy" , 600, "u1", "c2"},
+    };
+
+    auto returned_orders = cache.getAllOrders();
+    std::sort(std::begin(returned_orders), std::end(returned_orders));
+
+    ASSERT_EQ(expected_orders, returned_orders);
+
+    for(std::size_t i = 0; i < expected_orders.size(); ++i)
+    {
+        EXPECT_EQ(returned_orders[i].securityId(), expected_orders[i].securityId());
+        EXPECT_EQ(returned_orders[i].side(), expected_orders[i].side());
+        EXPECT_EQ(returned_orders[i].qty(), expected_orders[i].qty());
+        EXPECT_EQ(returned_orders[i].user(), expected_orders[i].user());
+        EXPECT_EQ(returned_orders[i].company(), expected_orders[i].company());
+    }
+
+    EXPECT_EQ(cache.getMatchingSizeForSecurity("s1"), 500);
+}
+
 TEST(OrderCacheTest, CancelsNotAddedOrder)
 {
     const std::vector<Order> added_orders{
@@ -418,3 +692,991 @@ TEST(OrderCacheTest, HandlesAddingOrderWithTheSameIdTwice)
 
     EXPECT_EQ(expected_orders, returned_orders);
 }
+
+TEST(OrderCacheTest, CancelsOrdersOfManyUsers)
+{
+    OrderCache cache;
+
+    for(int i = 0; i < 1000; ++i)
+    {
+        const auto n = std::to_string(i);
+        cache.addOrder({ "o" + n, "s" + std::to_string(i % 7), i % 2 ? "Buy" : "Sell", 100, "u" + std::to_string(i % 10), "c" + std::to_string(i % 3) });
+    }
+
+    for(int u = 0; u < 10; u += 2)
+    {
+        cache.cancelOrdersForUser("u" + std::to_string(u));
+    }
+
+    cache.cancelOrder("o1");
+    cache.cancelOrder("o3");
+
+    auto returned_orders = cache.getAllOrders();
+
+    EXPECT_EQ(returned_orders.size(), 498u);
+
+    for(const auto& order : returned_orders)
+    {
+        EXPECT_EQ(std::stoi(order.user().substr(1)) % 2, 1);
+    }
+}
+
+// Time needed to add `count` orders spread over many users and then cancel them all, user by user.
+static double timeCancelAllUsers(int count)
+{
+    OrderCache cache;
+
+    for(int i = 0; i < count; ++i)
+    {
+        cache.addOrder({ "o" + std::to_string(i), "s" + std::to_string(i % 50), i % 2 ? "Buy" : "Sell", 100, "u" + std::to_string(i % (count / 4)), "c" + std::to_string(i % 20) });
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+
+    for(int u = 0; u < count / 4; ++u)
+    {
+        cache.cancelOrdersForUser("u" + std::to_string(u));
+    }
+
+    const auto stop = std::chrono::steady_clock::now();
+
+    EXPECT_TRUE(cache.getAllOrders().empty());
+
+    return std::chrono::duration<double>(stop - start).count();
+}
+
+TEST(OrderCacheTest, CancelTimeScalesLinearlyWithOrderCount)
+{
+    // A linear removal gives a ratio close to 8, a removal that scans the whole index gives 64.
+    constexpr int small_count = 20000;
+    constexpr int large_count = 8 * small_count;
+
+    double small_time = timeCancelAllUsers(small_count);
+    double large_time = timeCancelAllUsers(large_count);
+
+    // Take the best of a few runs to filter out noise.
+    for(int run = 0; run < 2; ++run)
+    {
+        small_time = std::min(small_time, timeCancelAllUsers(small_count));
+        large_time = std::min(large_time, timeCancelAllUsers(large_count));
+    }
+
+    EXPECT_LT(large_time / small_time, 24.0);
+}
+
+TEST(OrderCacheTest, AddsOrdersInBatch)
+{
+    std::vector<Order> batch;
+
+    for(int i = 0; i < 2000; ++i)
+    {
+        batch.push_back({ "o" + std::to_string(i % 1500), "s" + std::to_string(i * 31 % 17), i % 3 ? "Buy" : "Sell", static_cast<unsigned int>(i % 250),
+            "u" + std::to_string(i % 9), "c" + std::to_string(i % 5) });
+    }
+
+    OrderCache batch_cache;
+    OrderCache cache;
+
+    batch_cache.addOrder({ "o7", "s99", "Sell", 1, "u99", "c99" });
+    cache.addOrder({ "o7", "s99", "Sell", 1, "u99", "c99" });
+
+    batch_cache.addOrders(batch);
+
+    for(const auto& order : batch)
+    {
+        cache.addOrder(order);
+    }
+
+    auto batch_orders = batch_cache.getAllOrders();
+    auto orders = cache.getAllOrders();
+
+    std::sort(std::begin(batch_orders), std::end(batch_orders));
+    std::sort(std::begin(orders), std::end(orders));
+
+    ASSERT_EQ(batch_orders, orders);
+
+    for(std::size_t i = 0; i < orders.size(); ++i)
+    {
+        EXPECT_EQ(batch_orders[i].securityId(), orders[i].securityId());
+        EXPECT_EQ(batch_orders[i].qty(), orders[i].qty());
+    }
+
+    for(int s = 0; s < 17; ++s)
+    {
+        const std::string security = "s" + std::to_string(s);
+        EXPECT_EQ(batch_cache.getMatchingSizeForSecurity(security), cache.getMatchingSizeForSecurity(security)) << security;
+    }
+
+    batch_cache.cancelOrdersForUser("u3");
+    cache.cancelOrdersForUser("u3");
+
+    EXPECT_EQ(batch_cache.getAllOrders().size(), cache.getAllOrders().size());
+}
+
+TEST(OrderCacheTest, CancelsOrdersInBatch)
+{
+    OrderCache cache;
+
+    for(int i = 0; i < 1000; ++i)
+    {
+        cache.addOrder({ "o" + std::to_string(i), "s" + std::to_string(i % 7), i % 2 ? "Buy" : "Sell", 100, "u" + std::to_string(i % 4), "c" + std::to_string(i % 3) });
+    }
+
+    std::vector<std::string> ids;
+
+    for(int i = 0; i < 1000; i += 2)
+    {
+        ids.push_back("o" + std::to_string(i));
+    }
+
+    ids.push_back("o0");
+    ids.push_back("o-unknown");
+
+    cache.cancelOrders({ std::begin(ids), std::end(ids) });
+
+    const auto orders = cache.getAllOrders();
+
+    EXPECT_EQ(orders.size(), 500u);
+
+    for(const auto& order : orders)
+    {
+        EXPECT_EQ(std::stoi(order.orderId().substr(1)) % 2, 1);
+    }
+
+    // Only buy orders are left.
+    EXPECT_EQ(cache.getMatchingSizeForSecurity("s1"), 0);
+
+    cache.cancelOrdersForUser("u1");
+    cache.cancelOrdersForUser("u3");
+
+    EXPECT_TRUE(cache.getAllOrders().empty());
+}
+
+static void expectSameOrders(const std::vector<Order>& actual, const std::vector<Order>& expected)
+{
+    ASSERT_EQ(actual.size(), expected.size());
+
+    for(std::size_t i = 0; i < actual.size(); ++i)
+    {
+        EXPECT_EQ(actual[i].orderId(), expected[i].orderId());
+        EXPECT_EQ(actual[i].securityId(), expected[i].securityId());
+        EXPECT_EQ(actual[i].side(), expected[i].side());
+        EXPECT_EQ(actual[i].qty(), expected[i].qty());
+        EXPECT_EQ(actual[i].user(), expected[i].user());
+        EXPECT_EQ(actual[i].company(), expected[i].company());
+    }
+}
+
+TEST(OrderCacheTest, RestoresStateFromSnapshot)
+{
+    const auto path = (std::filesystem::temp_directory_path() / "OrderCacheTest.RestoresStateFromSnapshot.snap").string();
+
+    OrderCache cache;
+
+    for(int i = 0; i < 3000; ++i)
+    {
+        cache.addOrder({ "OrderWithALongIdentifier" + std::to_string(i), "s" + std::to_string(i % 13), i % 3 ? "Buy" : "Sell",
+            static_cast<unsigned int>(i % 700), "u" + std::to_string(i % 11), "c" + std::to_string(i % 7) });
+    }
+
+    // Leave free slots and stale aggregates behind.
+    cache.cancelOrdersForUser("u4");
+    cache.cancelOrdersForSecIdWithMinimumQty("s2", 300);
+    cache.cancelOrder("OrderWithALongIdentifier1");
+
+    cache.saveSnapshot(path);
+
+    OrderCache restored;
+    restored.addOrder({ "o1", "s1", "Buy", 100, "u1", "c1" });
+    restored.loadSnapshot(path);
+
+    expectSameOrders(restored.getAllOrders(), cache.getAllOrders());
+
+    // The restored cache keeps working like the original.
+    for(auto* c : { &cache, &restored })
+    {
+        c->cancelOrdersForUser("u5");
+        c->cancelOrder("OrderWithALongIdentifier2");
+        c->addOrder({ "new1", "s3", "Sell", 500, "u1", "c9" });
+        c->addOrder({ "OrderWithALongIdentifier3", "s3", "Sell", 500, "u1", "c9" });
+    }
+
+    expectSameOrders(restored.getAllOrders(), cache.getAllOrders());
+
+    // The loaded order ids move into the arena, with orders added and removed along the way.
+    for(int i = 0; !restored.compact(64).done; ++i)
+    {
+        restored.cancelOrder("OrderWithALongIdentifier" + std::to_string(100 + i));
+        restored.addOrder({ "after" + std::to_string(i), "s4", "Buy", 10, "u2", "c2" });
+        cache.cancelOrder("OrderWithALongIdentifier" + std::to_string(100 + i));
+        cache.addOrder({ "after" + std::to_string(i), "s4", "Buy", 10, "u2", "c2" });
+    }
+
+    // Compaction moves orders to other slots, which changes the order they are returned in.
+    auto restored_orders = restored.getAllOrders();
+    auto orders = cache.getAllOrders();
+
+    std::sort(std::begin(restored_orders), std::end(restored_orders));
+    std::sort(std::begin(orders), std::end(orders));
+
+    expectSameOrders(restored_orders, orders);
+
+    for(int s = 0; s < 13; ++s)
+    {
+        const std::string security = "s" + std::to_string(s);
+        EXPECT_EQ(restored.getMatchingSizeForSecurity(security), cache.getMatchingSizeForSecurity(security)) << security;
+    }
+
+    std::filesystem::remove(path);
+}
+
+TEST(OrderCacheTest, RejectsBadSnapshot)
+{
+    const auto path = (std::filesystem::temp_directory_path() / "OrderCacheTest.RejectsBadSnapshot.snap").string();
+
+    OrderCache cache;
+    cache.addOrder({ "o1", "s1", "Buy", 100, "u1", "c1" });
+    cache.saveSnapshot(path);
+
+    const auto size = std::filesystem::file_size(path);
+    std::filesystem::resize_file(path, size - 3);
+
+    OrderCache restored;
+    restored.addOrder({ "o2", "s2", "Sell", 200, "u2", "c2" });
+
+    EXPECT_THROW(restored.loadSnapshot(path), std::runtime_error);
+    EXPECT_THROW(restored.loadSnapshot(path + ".missing"), std::runtime_error);
+
+    {
+        std::ofstream file{ path, std::ios::binary | std::ios::trunc };
+        file << "not a snapshot at all";
+    }
+
+    EXPECT_THROW(restored.loadSnapshot(path), std::runtime_error);
+
+    const auto orders = restored.getAllOrders();
+
+    ASSERT_EQ(orders.size(), 1u);
+    EXPECT_EQ(orders[0].orderId(), "o2");
+
+    std::filesystem::remove(path);
+}
+
+TEST(OrderCacheTest, RejectsCorruptSnapshotOfTheRightSize)
+{
+    const auto path = (std::filesystem::temp_directory_path() / "OrderCacheTest.RejectsCorruptSnapshotOfTheRightSize.snap").string();
+
+    OrderCache cache;
+
+    for(int i = 0; i < 6; ++i)
+    {
+        cache.addOrder({ "o" + std::to_string(i), "s" + std::to_string(i % 2), i % 3 ? "Buy" : "Sell",
+            static_cast<unsigned int>(100 * (i + 1)), "u" + std::to_string(i % 3), "c" + std::to_string(i % 2) });
+    }
+
+    cache.cancelOrder("o4");
+    cache.saveSnapshot(path);
+
+    std::vector<char> bytes;
+
+    {
+        std::ifstream file{ path, std::ios::binary };
+        bytes.assign(std::istreambuf_iterator<char>{ file }, std::istreambuf_iterator<char>{});
+    }
+
+    const auto write = [&path](const std::vector<char>& contents)
+    {
+        std::ofstream file{ path, std::ios::binary | std::ios::trunc };
+        file.write(contents.data(), static_cast<std::streamsize>(contents.size()));
+    };
+
+    std::size_t rejected = 0;
+
+    // Every byte changed in turn fails the checksum. With the checksum made to match, it either
+    // fails the check of the references or leaves a cache that works.
+    for(std::size_t at = 0; at < bytes.size(); ++at)
+    {
+        std::vector<char> corrupt = bytes;
+        corrupt[at] = static_cast<char>(corrupt[at] ^ 0x5a);
+
+        write(corrupt);
+
+        EXPECT_THROW(OrderCache{}.loadSnapshot(path), std::runtime_error) << at;
+
+        const std::size_t data_size = corrupt.size() - sizeof(std::uint64_t);
+
+        if(at >= data_size)
+        {
+            continue;
+        }
+
+        SnapshotChecksum checksum;
+        checksum.update(corrupt.data(), data_size);
+
+        const std::uint64_t sum = checksum.value();
+        std::memcpy(corrupt.data() + data_size, &sum, sizeof(sum));
+
+        write(corrupt);
+
+        OrderCache restored;
+
+        try
+        {
+            restored.loadSnapshot(path, OrderCache::SnapshotCheck::References);
+        }
+        catch(const std::runtime_error&)
+        {
+            ++rejected;
+            continue;
+        }
+
+        restored.addOrder({ "o9", "s1", "Sell", 50, "u1", "c1" });
+        restored.getMatchingSizeForSecurity("s0");
+        restored.cancelOrdersForSecIdWithMinimumQty("s1", 200);
+        restored.cancelOrdersForUser("u0");
+        restored.cancelOrdersForCompany("c1");
+        restored.cancelOrder("o1");
+
+        EXPECT_LE(restored.getAllOrders().size(), 6u) << at;
+    }
+
+    EXPECT_GT(rejected, bytes.size() / 2);
+
+    write(bytes);
+
+    EXPECT_NO_THROW(OrderCache{}.loadSnapshot(path, OrderCache::SnapshotCheck::References));
+
+    std::filesystem::remove(path);
+}
+
+TEST(OrderCacheTest, VisitsOrdersInPlace)
+{
+    OrderCache cache;
+
+    for(int i = 0; i < 100; ++i)
+    {
+        cache.addOrder({ "o" + std::to_string(i), "s" + std::to_string(i % 3), i % 2 ? "Buy" : "Sell",
+            static_cast<unsigned int>(i), "u" + std::to_string(i % 4), "c" + std::to_string(i % 5) });
+    }
+
+    cache.cancelOrdersForUser("u1");
+
+    std::vector<Order> visited;
+    EXPECT_EQ(cache.forEachOrder([&](const OrderView& order) { visited.push_back(order.toOrder()); }), order_cursor_end);
+    expectSameOrders(visited, cache.getAllOrders());
+
+    // Pages of 10 visit the same orders as a single walk.
+    std::vector<Order> paged;
+    OrderCursor cursor = 0;
+
+    while(order_cursor_end != cursor)
+    {
+        std::size_t page = 0;
+
+        cursor = cache.forEachOrder([&](const OrderView& order)
+        {
+            paged.push_back(order.toOrder());
+            return ++page < 10;
+        }, cursor);
+
+        EXPECT_LE(page, 10u);
+    }
+
+    expectSameOrders(paged, visited);
+
+    // Filtered walks see exactly the orders with that field.
+    const auto expectOnly = [&](const auto& field, const std::string& name, auto walk)
+    {
+        std::vector<std::string> expected;
+
+        for(const Order& order : visited)
+        {
+            if(field(order) == name)
+            {
+                expected.push_back(order.orderId());
+            }
+        }
+
+        std::vector<std::string> actual;
+        walk([&](const OrderView& order) { actual.emplace_back(order.order_id); });
+
+        std::sort(expected.begin(), expected.end());
+        std::sort(actual.begin(), actual.end());
+
+        EXPECT_EQ(actual, expected) << name;
+    };
+
+    expectOnly([](const Order& o) { return o.securityId(); }, "s2",
+        [&](auto visit) { cache.forEachOrderForSecurity("s2", visit); });
+    expectOnly([](const Order& o) { return o.user(); }, "u3",
+        [&](auto visit) { cache.forEachOrderForUser("u3", visit); });
+    expectOnly([](const Order& o) { return o.company(); }, "c0",
+        [&](auto visit) { cache.forEachOrderForCompany("c0", visit); });
+    expectOnly([](const Order& o) { return o.user(); }, "u1",
+        [&](auto visit) { cache.forEachOrderForUser("u1", visit); });
+
+    EXPECT_EQ(cache.forEachOrderForSecurity("unknown", [](const OrderView&) { ADD_FAILURE(); }), order_cursor_end);
+}
+
+TEST(OrderCacheTest, ClearsAllOrders)
+{
+    OrderCache cache;
+
+    for(int i = 0; i < 1000; ++i)
+    {
+        cache.addOrder({ "OrderWithALongIdentifier" + std::to_string(i), "s" + std::to_string(i % 3), i % 2 ? "Buy" : "Sell",
+            100, "u" + std::to_string(i % 4), "c" + std::to_string(i % 5) });
+    }
+
+    std::vector<std::string> changed;
+    cache.takeChangedSecurities(changed);
+
+    cache.clear();
+
+    EXPECT_TRUE(cache.getAllOrders().empty());
+    EXPECT_EQ(cache.getMatchingSizeForSecurity("s1"), 0u);
+    EXPECT_FALSE(cache.containsOrder("OrderWithALongIdentifier1"));
+
+    // Every security that had orders is reported as changed.
+    changed.clear();
+    cache.takeChangedSecurities(changed);
+    std::sort(changed.begin(), changed.end());
+
+    EXPECT_EQ(changed, (std::vector<std::string>{ "s0", "s1", "s2" }));
+
+    // The cache works as new afterwards.
+    cache.addOrder({ "OrderWithALongIdentifier1", "s1", "Buy", 100, "u1", "c1" });
+    cache.addOrder({ "OrderWithALongIdentifier2", "s1", "Sell", 300, "u2", "c2" });
+
+    EXPECT_EQ(cache.getMatchingSizeForSecurity("s1"), 100u);
+    EXPECT_EQ(cache.getAllOrders().size(), 2u);
+
+    cache.cancelOrdersForUser("u1");
+
+    EXPECT_EQ(cache.getAllOrders().size(), 1u);
+}
+
+TEST(OrderCacheTest, RejectsOrdersWithInvalidSide)
+{
+    OrderCache cache;
+
+    cache.addOrder({ "o1", "s1", "Buy", 100, "u1", "c1" });
+    cache.addOrder({ "o2", "s1", "buy", 100, "u1", "c1" });
+    cache.addOrder({ "o3", "s1", "", 100, "u1", "c1" });
+    cache.addOrder({ "o4", "s1", "Sell ", 100, "u1", "c1" });
+    cache.addOrder({ "o5", "s1", "Sell", 300, "u2", "c2" });
+
+    EXPECT_EQ(cache.rejectedOrderCount(), 3u);
+    EXPECT_EQ(cache.getAllOrders().size(), 2u);
+    EXPECT_FALSE(cache.containsOrder("o2"));
+    EXPECT_EQ(cache.getMatchingSizeForSecurity("s1"), 100u);
+
+    // A rejected order leaves its id free.
+    cache.addOrder({ "o2", "s1", "Sell", 100, "u3", "c3" });
+
+    EXPECT_TRUE(cache.containsOrder("o2"));
+    EXPECT_EQ(cache.getMatchingSizeForSecurity("s1"), 100u);
+}
+
+TEST(OrderCacheTest, VisitsOrdersOfOneSide)
+{
+    OrderCache cache;
+
+    for(int i = 0; i < 50; ++i)
+    {
+        cache.addOrder({ "o" + std::to_string(i), "s" + std::to_string(i % 2), i % 3 ? "Buy" : "Sell",
+            static_cast<unsigned int>(i), "u" + std::to_string(i % 4), "c" + std::to_string(i % 5) });
+    }
+
+    for(const Side side : { Side::Buy, Side::Sell })
+    {
+        std::size_t visited = 0;
+
+        cache.forEachOrderForSecurity("s1", side, [&](const OrderView& order)
+        {
+            EXPECT_EQ(order.security_id, "s1");
+            EXPECT_EQ(order.side, sideName(side));
+            ++visited;
+        });
+
+        // Odd ids of s1, of which ids divisible by 3 are sells.
+        EXPECT_EQ(visited, Side::Sell == side ? 8u : 17u);
+    }
+
+    // Pages of 4 cross from the buy orders to the sell ones without missing any.
+    std::vector<std::string> paged;
+    OrderCursor cursor = 0;
+
+    while(order_cursor_end != cursor)
+    {
+        std::size_t page = 0;
+
+        cursor = cache.forEachOrderForSecurity("s1", [&](const OrderView& order)
+        {
+            paged.emplace_back(order.order_id);
+            return ++page < 4;
+        }, cursor);
+    }
+
+    std::sort(paged.begin(), paged.end());
+
+    EXPECT_EQ(paged.size(), 25u);
+    EXPECT_EQ(std::unique(paged.begin(), paged.end()), paged.end());
+}
+
+TEST(OrderCacheTest, TracksAndCancelsCompanyOrders)
+{
+    OrderCache cache;
+
+    for(int i = 0; i < 300; ++i)
+    {
+        cache.addOrder({ "o" + std::to_string(i), "s" + std::to_string(i % 7), i % 3 ? "Buy" : "Sell",
+            static_cast<unsigned int>(1 + i), "u" + std::to_string(i % 11), "c" + std::to_string(i % 4) });
+    }
+
+    cache.cancelOrdersForUser("u2");
+    cache.cancelOrdersForSecIdWithMinimumQty("s3", 200);
+
+    // The running totals agree with the orders left.
+    const auto expectOpenQty = [&](const std::string& company, const std::string& security)
+    {
+        unsigned long long buy = 0;
+        unsigned long long sell = 0;
+
+        for(const Order& order : cache.getAllOrders())
+        {
+            if(order.company() == company && order.securityId() == security)
+            {
+                ("Sell" == order.side() ? sell : buy) += order.qty();
+            }
+        }
+
+        const OrderCache::OpenQty qty = cache.getOpenQtyForCompany(company, security);
+
+        EXPECT_EQ(qty.buy, buy) << company << " " << security;
+        EXPECT_EQ(qty.sell, sell) << company << " " << security;
+    };
+
+    for(int c = 0; c < 4; ++c)
+    {
+        for(int s = 0; s < 7; ++s)
+        {
+            expectOpenQty("c" + std::to_string(c), "s" + std::to_string(s));
+        }
+    }
+
+    EXPECT_EQ(cache.getOpenQtyForCompany("unknown", "s1").total(), 0u);
+    EXPECT_EQ(cache.getOpenQtyForCompany("c1", "unknown").total(), 0u);
+
+    const std::size_t orders = cache.getAllOrders().size();
+    std::size_t company_orders = 0;
+    cache.forEachOrderForCompany("c1", [&](const OrderView&) { ++company_orders; });
+
+    std::vector<std::string> cancelled;
+    cache.cancelOrdersForCompany("c1", cancelled);
+
+    EXPECT_EQ(cancelled.size(), company_orders);
+    EXPECT_EQ(cache.getAllOrders().size(), orders - company_orders);
+
+    for(const Order& order : cache.getAllOrders())
+    {
+        EXPECT_NE(order.company(), "c1");
+    }
+
+    for(int s = 0; s < 7; ++s)
+    {
+        EXPECT_EQ(cache.getOpenQtyForCompany("c1", "s" + std::to_string(s)).total(), 0u);
+        expectOpenQty("c2", "s" + std::to_string(s));
+    }
+
+    // The user index no longer holds the cancelled orders.
+    cache.cancelOrdersForUser("u1");
+
+    for(const Order& order : cache.getAllOrders())
+    {
+        EXPECT_NE(order.user(), "u1");
+    }
+}
+
+TEST(OrderCacheTest, ComputesMatchingSizesOfAllSecuritiesInParallel)
+{
+    OrderCache cache;
+    OrderCache reference;
+
+    std::mt19937 rng{ 7 };
+
+    // Enough securities for several chunks per thread.
+    for(int i = 0; i < 40000; ++i)
+    {
+        const Order order{ "o" + std::to_string(i), "s" + std::to_string(i % 5000), rng() % 2 ? "Buy" : "Sell",
+            1 + static_cast<unsigned int>(rng() % 1000), "u" + std::to_string(rng() % 50), "c" + std::to_string(rng() % 8) };
+
+        cache.addOrder(order);
+        reference.addOrder(order);
+    }
+
+    for(int u = 0; u < 50; u += 7)
+    {
+        cache.cancelOrdersForUser("u" + std::to_string(u));
+        reference.cancelOrdersForUser("u" + std::to_string(u));
+    }
+
+    const auto [security_ids, sizes] = cache.getMatchingSizeForAllSecurities(4);
+
+    ASSERT_EQ(sizes.size(), security_ids.size());
+    EXPECT_EQ(sizes.size(), 5000u);
+
+    for(std::size_t i = 0; i < sizes.size(); ++i)
+    {
+        EXPECT_EQ(sizes[i], reference.getMatchingSizeForSecurity(std::string{ security_ids[i] })) << security_ids[i];
+    }
+
+    // A list may hold unknown and repeated securities.
+    cache.cancelOrdersForSecIdWithMinimumQty("s3", 500);
+    reference.cancelOrdersForSecIdWithMinimumQty("s3", 500);
+
+    const std::vector<std::string> listed{ "s3", "unknown", "s3", "s4999" };
+
+    EXPECT_EQ(cache.getMatchingSizeForSecurities(listed, 4), (std::vector<unsigned int>{
+        reference.getMatchingSizeForSecurity("s3"), 0, reference.getMatchingSizeForSecurity("s3"), reference.getMatchingSizeForSecurity("s4999") }));
+}
+
+TEST(OrderCacheTest, QueriesOrdersOfSecurityByQty)
+{
+    OrderCache cache;
+
+    for(int i = 0; i < 2000; ++i)
+    {
+        cache.addOrder({ "o" + std::to_string(i), "s" + std::to_string(i % 3), i % 2 ? "Buy" : "Sell",
+            static_cast<unsigned int>(1 + i * 7 % 3000), "u" + std::to_string(i % 4), "c" + std::to_string(i % 5) });
+    }
+
+    cache.cancelOrdersForUser("u2");
+    cache.cancelOrdersForSecIdWithMinimumQty("s1", 2500);
+
+    const auto expectRange = [&](unsigned int min_qty, unsigned int max_qty)
+    {
+        std::vector<std::string> expected;
+        OrderCache::OpenQty expected_qty;
+
+        for(const Order& order : cache.getAllOrders())
+        {
+            if(order.securityId() != "s1")
+            {
+                continue;
+            }
+
+            if(order.qty() >= min_qty && order.qty() <= max_qty)
+            {
+                expected.push_back(order.orderId());
+            }
+
+            if(order.qty() >= min_qty)
+            {
+                ("Sell" == order.side() ? expected_qty.sell : expected_qty.buy) += order.qty();
+            }
+        }
+
+        std::vector<std::string> actual;
+        cache.forEachOrderForSecurityInQtyRange("s1", min_qty, max_qty, [&](const OrderView& order)
+        {
+            EXPECT_GE(order.qty, min_qty);
+            EXPECT_LE(order.qty, max_qty);
+            actual.emplace_back(order.order_id);
+        });
+
+        std::sort(expected.begin(), expected.end());
+        std::sort(actual.begin(), actual.end());
+
+        EXPECT_EQ(actual, expected) << min_qty << " " << max_qty;
+
+        const OrderCache::OpenQty qty = cache.getOpenQtyForSecurityWithMinimumQty("s1", min_qty);
+
+        EXPECT_EQ(qty.buy, expected_qty.buy) << min_qty;
+        EXPECT_EQ(qty.sell, expected_qty.sell) << min_qty;
+    };
+
+    expectRange(0, 3000);
+    expectRange(100, 200);
+    expectRange(1000, 1000);
+    expectRange(2400, 2600);
+    expectRange(2600, 2400);
+
+    int visited = 0;
+    cache.forEachOrderForSecurityInQtyRange("s1", 0, 3000, [&](const OrderView&) { return ++visited < 10; });
+
+    EXPECT_EQ(visited, 10);
+    EXPECT_EQ(cache.getOpenQtyForSecurityWithMinimumQty("unknown", 0).total(), 0u);
+}
+
+TEST(OrderCacheTest, NotifiesMatchingSizeChangesOfSubscribedSecurities)
+{
+    OrderCache cache;
+
+    cache.addOrder({ "o1", "s1", "Buy", 100, "u1", "c1" });
+    cache.subscribeMatchingSize("s1");
+    cache.subscribeMatchingSize("s2");
+
+    std::map<std::string, std::pair<unsigned int, unsigned int>> changes;
+
+    const auto takeChanges = [&]
+    {
+        std::vector<OrderCache::MatchingSizeChange> taken;
+        cache.takeMatchingSizeChanges(taken);
+
+        changes.clear();
+
+        for(const auto& change : taken)
+        {
+            EXPECT_TRUE(changes.emplace(std::string{ change.securityId }, std::make_pair(change.previous, change.current)).second);
+        }
+    };
+
+    // Orders which leave the matching size as it was are not reported, nor are unsubscribed securities.
+    cache.addOrder({ "o2", "s1", "Buy", 50, "u1", "c1" });
+    cache.addOrder({ "o3", "s3", "Sell", 50, "u2", "c2" });
+    takeChanges();
+    EXPECT_TRUE(changes.empty());
+
+    cache.addOrder({ "o4", "s1", "Sell", 120, "u2", "c2" });
+    cache.addOrder({ "o5", "s2", "Sell", 70, "u2", "c2" });
+    cache.addOrder({ "o6", "s2", "Buy", 30, "u1", "c1" });
+    takeChanges();
+    EXPECT_EQ(changes, (std::map<std::string, std::pair<unsigned int, unsigned int>>{ { "s1", { 0, 120 } }, { "s2", { 0, 30 } } }));
+
+    // A mass cancel reports each security once, from the size reported last.
+    for(int i = 0; i < 100; ++i)
+    {
+        cache.addOrder({ "m" + std::to_string(i), "s" + std::to_string(1 + i % 2), "Buy", 10, "u9", "c9" });
+    }
+
+    cache.cancelOrdersForUser("u9");
+    takeChanges();
+    EXPECT_TRUE(changes.empty());
+
+    std::vector<OrderCache::MatchingSizeChange> delivered;
+    cache.setMatchingSizeListener([&](const OrderCache::MatchingSizeChange& change) { delivered.push_back(change); });
+
+    cache.cancelOrdersForUser("u2");
+
+    ASSERT_EQ(delivered.size(), 2u);
+    EXPECT_EQ(delivered[0].current + delivered[1].current, 0u);
+
+    cache.unsubscribeMatchingSize("s2");
+    cache.addOrder({ "o7", "s2", "Sell", 30, "u3", "c3" });
+    cache.addOrder({ "o8", "s1", "Sell", 40, "u3", "c3" });
+
+    ASSERT_EQ(delivered.size(), 3u);
+    EXPECT_EQ(delivered[2].securityId, "s1");
+    EXPECT_EQ(delivered[2].current, 40u);
+
+    // Subscriptions survive loading a snapshot, which reports the sizes that differ.
+    const auto path = (std::filesystem::temp_directory_path() / "OrderCacheTest.NotifiesMatchingSizeChanges.snap").string();
+
+    OrderCache other;
+    other.addOrder({ "p1", "s1", "Buy", 25, "u1", "c1" });
+    other.addOrder({ "p2", "s1", "Sell", 25, "u2", "c2" });
+    other.saveSnapshot(path);
+
+    cache.loadSnapshot(path);
+    std::filesystem::remove(path);
+
+    ASSERT_EQ(delivered.size(), 4u);
+    EXPECT_EQ(delivered[3].securityId, "s1");
+    EXPECT_EQ(delivered[3].previous, 40u);
+    EXPECT_EQ(delivered[3].current, 25u);
+}
+
+TEST(OrderCacheTest, AmendsAndReducesQtyInPlace)
+{
+    // Amending must leave the cache as cancelling the order and adding it with the new qty does.
+    OrderCache amended;
+    OrderCache replaced;
+
+    std::mt19937 rng{ 11 };
+
+    std::vector<Order> orders;
+
+    for(int i = 0; i < 3000; ++i)
+    {
+        orders.push_back({ "o" + std::to_string(i), "s" + std::to_string(i % 7), rng() % 2 ? "Buy" : "Sell",
+            1 + static_cast<unsigned int>(rng() % 2000), "u" + std::to_string(i % 9), "c" + std::to_string(i % 4) });
+    }
+
+    amended.addOrders(orders);
+    replaced.addOrders(orders);
+
+    const auto replace = [&](const Order& order, unsigned int qty)
+    {
+        replaced.cancelOrder(order.orderId());
+
+        if(0 != qty)
+        {
+            replaced.addOrder({ order.orderId(), order.securityId(), order.side(), qty, order.user(), order.company() });
+        }
+    };
+
+    const auto sorted = [](std::vector<Order> orders)
+    {
+        std::sort(orders.begin(), orders.end());
+        return orders;
+    };
+
+    for(int step = 0; step < 6000; ++step)
+    {
+        Order& order = orders[rng() % orders.size()];
+
+        if(0 == order.qty())
+        {
+            continue;
+        }
+
+        // Small changes keep the order in its rung, large ones move it; some orders fill completely.
+        unsigned int qty = 0;
+
+        if(rng() % 2)
+        {
+            const unsigned int delta = rng() % 3 ? 1 + rng() % 8 : 1 + rng() % 2000;
+
+            amended.reduceQty(order.orderId(), delta);
+            qty = delta >= order.qty() ? 0 : order.qty() - delta;
+        }
+        else
+        {
+            qty = rng() % 10 ? static_cast<unsigned int>(rng() % 4000) : 0;
+
+            amended.amendQty(order.orderId(), qty);
+        }
+
+        replace(order, qty);
+
+        order = { order.orderId(), order.securityId(), order.side(), qty, order.user(), order.company() };
+    }
+
+    expectSameOrders(sorted(amended.getAllOrders()), sorted(replaced.getAllOrders()));
+
+    for(int s = 0; s < 7; ++s)
+    {
+        const std::string security = "s" + std::to_string(s);
+
+        EXPECT_EQ(amended.getMatchingSizeForSecurity(security), replaced.getMatchingSizeForSecurity(security)) << security;
+        EXPECT_EQ(amended.getOpenQtyForSecurityWithMinimumQty(security, 1000).total(), replaced.getOpenQtyForSecurityWithMinimumQty(security, 1000).total()) << security;
+    }
+
+    // The indexes still find every order: cancel through each of them.
+    amended.cancelOrdersForSecIdWithMinimumQty("s3", 500);
+    replaced.cancelOrdersForSecIdWithMinimumQty("s3", 500);
+    amended.cancelOrdersForUser("u2");
+    replaced.cancelOrdersForUser("u2");
+    amended.cancelOrdersForCompany("c1");
+    replaced.cancelOrdersForCompany("c1");
+
+    expectSameOrders(sorted(amended.getAllOrders()), sorted(replaced.getAllOrders()));
+
+    amended.amendQty("unknown", 10);
+    amended.reduceQty("unknown", 10);
+
+    // Amending to 0 removes an order added with qty 0 as well.
+    amended.addOrder({ "zero", "s1", "Buy", 0, "u1", "c1" });
+    ASSERT_TRUE(amended.containsOrder("zero"));
+
+    amended.amendQty("zero", 0);
+    EXPECT_FALSE(amended.containsOrder("zero"));
+}
+
+TEST(OrderCacheTest, CompactsStorageIncrementally)
+{
+    OrderCache cache;
+
+    for(int i = 0; i < 50000; ++i)
+    {
+        cache.addOrder({ "o" + std::to_string(i), "s" + std::to_string(i % 50), i % 2 ? "Buy" : "Sell",
+            static_cast<unsigned int>(1 + i * 13 % 5000), "u" + std::to_string(i % 40), "c" + std::to_string(i % 7) });
+    }
+
+    // An end of day sweep leaves a few orders spread over the whole store.
+    for(int u = 1; u < 40; ++u)
+    {
+        cache.cancelOrdersForUser("u" + std::to_string(u));
+    }
+
+    const std::vector<Order> remaining = cache.getAllOrders();
+
+    OrderCache expected;
+    expected.addOrders(remaining);
+
+    const std::size_t peak_bytes = cache.memoryBytes();
+
+    int calls = 0;
+
+    for(OrderCache::CompactProgress progress; !progress.done; ++calls)
+    {
+        progress = cache.compact(256);
+
+        if(progress.done)
+        {
+            // Only the last call of the pass measures the memory.
+            EXPECT_EQ(progress.bytes_after, cache.memoryBytes());
+            EXPECT_LT(progress.bytes_after * 4, progress.bytes_before);
+            break;
+        }
+
+        EXPECT_EQ(progress.bytes_before, 0u);
+
+        // Orders may come and go between the steps.
+        cache.addOrder({ "n" + std::to_string(calls), "s1", "Sell", 100, "u0", "c1" });
+        expected.addOrder({ "n" + std::to_string(calls), "s1", "Sell", 100, "u0", "c1" });
+
+        if(calls % 2)
+        {
+            cache.cancelOrder("n" + std::to_string(calls - 1));
+            expected.cancelOrder("n" + std::to_string(calls - 1));
+        }
+    }
+
+    EXPECT_GT(calls, 10);
+    EXPECT_LT(cache.memoryBytes() * 4, peak_bytes);
+
+#ifdef ORDERCACHE_STATS
+    const OrderCacheStats stats = cache.stats();
+    EXPECT_EQ(stats.order_slots, stats.orders);
+#endif
+
+    const auto sorted = [](std::vector<Order> orders)
+    {
+        std::sort(orders.begin(), orders.end());
+        return orders;
+    };
+
+    expectSameOrders(sorted(cache.getAllOrders()), sorted(expected.getAllOrders()));
+
+    // Every index still finds the orders moved to other slots.
+    for(auto* c : { &cache, &expected })
+    {
+        c->reduceQty("o40", 1);
+        c->cancelOrdersForSecIdWithMinimumQty("s3", 2000);
+        c->cancelOrdersForCompany("c2");
+        c->cancelOrder("o80");
+    }
+
+    expectSameOrders(sorted(cache.getAllOrders()), sorted(expected.getAllOrders()));
+
+    for(int s = 0; s < 50; ++s)
+    {
+        const std::string security = "s" + std::to_string(s);
+        EXPECT_EQ(cache.getMatchingSizeForSecurity(security), expected.getMatchingSizeForSecurity(security)) << security;
+    }
+
+    cache.cancelOrdersForUser("u0");
+    EXPECT_TRUE(cache.getAllOrders().empty());
+
+    // Every empty rung is dropped by a step of its own.
+    int empty_calls = 1;
+
+    while(!cache.compact().done)
+    {
+        ++empty_calls;
+    }
+
+    EXPECT_LT(empty_calls, 10);
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include "OrderCacheInterface.h"
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <tuple>
+#include <vector>
+
+// Helpers shared by the tests of the order caches.
+
+using OrderFields = std::tuple<std::string, std::string, std::string, unsigned int, std::string, std::string>;
+
+// return the fields of the orders, sorted, to compare caches which list orders in different orders
+inline std::vector<OrderFields> sortedFields(const std::vector<Order>& orders)
+{
+    std::vector<OrderFields> fields;
+
+    for(const auto& o : orders)
+    {
+        fields.emplace_back(o.orderId(), o.securityId(), o.side(), o.qty(), o.user(), o.company());
+    }
+
+    std::sort(std::begin(fields), std::end(fields));
+
+    return fields;
+}
+
+// One call done by a writer thread, replayed later on a single-threaded OrderCache.
+struct Operation
+{
+    enum class Kind { Add, Cancel, CancelUser, CancelSecurityMinQty, MatchingSize } kind;
+
+    Order order;
+    unsigned int min_qty;
+};
+
+// make the call of the operation on the cache
+inline void apply(OrderCacheInterface& cache, const Operation& op)
+{
+    switch(op.kind)
+    {
+    case Operation::Kind::Add:                  cache.addOrder(op.order); break;
+    case Operation::Kind::Cancel:               cache.cancelOrder(op.order.orderId()); break;
+    case Operation::Kind::CancelUser:           cache.cancelOrdersForUser(op.order.user()); break;
+    case Operation::Kind::CancelSecurityMinQty: cache.cancelOrdersForSecIdWithMinimumQty(op.order.securityId(), op.min_qty); break;
+    case Operation::Kind::MatchingSize:         cache.getMatchingSizeForSecurity(op.order.securityId()); break;
+    }
+}
+
+/*
+   Writer t owns its order ids, its users and its private securities "p<t>-0" to "p<t>-3", and adds
+   orders to the shared securities "s0" to "s39" too. Operations of different writers then commute,
+   so any interleaving must end in the state of replaying the writers one after another.
+*/
+inline std::vector<Operation> makeOperations(int writer, int count)
+{
+    std::mt19937 rng{ static_cast<unsigned int>(writer) };
+
+    const std::string prefix = std::to_string(writer);
+
+    std::vector<Operation> ops;
+
+    for(int i = 0; i < count; ++i)
+    {
+        const auto r = rng() % 100;
+
+        const std::string order_id = "o" + prefix + "-" + std::to_string(rng() % (count / 2));
+        const std::string security = rng() % 2 ? "s" + std::to_string(rng() % 40) : "p" + prefix + "-" + std::to_string(rng() % 4);
+        const std::string user = "u" + prefix + "-" + std::to_string(rng() % 8);
+        const std::string company = "c" + std::to_string(rng() % 6);
+        const unsigned int qty = 1 + rng() % 1000;
+
+        Order order{ order_id, security, rng() % 2 ? "Buy" : "Sell", qty, user, company };
+
+        if(r < 70)
+        {
+            ops.push_back({ Operation::Kind::Add, order, 0 });
+        }
+        else if(r < 92)
+        {
+            ops.push_back({ Operation::Kind::Cancel, order, 0 });
+        }
+        else if(r < 96)
+        {
+            ops.push_back({ Operation::Kind::CancelUser, order, 0 });
+        }
+        else if(r < 98)
+        {
+            Order private_security_order{ order_id, "p" + prefix + "-" + std::to_string(rng() % 4), "Buy", qty, user, company };
+
+            ops.push_back({ Operation::Kind::CancelSecurityMinQty, private_security_order, 1 + static_cast<unsigned int>(rng() % 1000) });
+        }
+        else
+        {
+            ops.push_back({ Operation::Kind::MatchingSize, order, 0 });
+        }
+    }
+
+    return ops;
+}
@@ -0,0 +1,330 @@
+#include "OrderIdTable.h"
+#include "Snapshot.h"
+
+#include <algorithm>
+#include <functional>
+#include <utility>
+
+OrderSlot OrderIdTable::find(std::string_view order_id, const OrderStore& store) const noexcept
+{
+    if(0 == count)
+    {
+        return none;
+    }
+
+    const std::uint32_t hash = hashOf(order_id);
+
+    if(const OrderSlot slot = find(entries, hash, order_id, store); none != slot || !shrinking())
+    {
+        return slot;
+    }
+
+    return find(old_entries, hash, order_id, store);
+}
+
+OrderSlot OrderIdTable::find(const Entries& table, std::uint32_t hash, std::string_view order_id, const OrderStore& store) noexcept
+{
+    for(std::size_t pos = home(table, hash), dist = 0; ; pos = (pos + 1) & mask(table), ++dist)
+    {
+        const Entry& entry = table[pos];
+
+        // An empty entry or an entry closer to its home than the id would be ends the probe.
+        if(none == entry.slot || distance(table, pos) < dist)
+        {
+            return none;
+        }
+
+        if(entry.hash == hash && store.order_id[entry.slot] == order_id)
+        {
+            return entry.slot;
+        }
+    }
+}
+
+void OrderIdTable::insert(std::string_view order_id, OrderSlot slot)
+{
+    // Keep the load factor at most 7/8, counting the entries still to move.
+    if((count + 1) * 8 > entries.size() * 7)
+    {
+        rehash(entries.empty() ? 16 : entries.size() * 2);
+    }
+
+    place(entries, Entry{ slot, hashOf(order_id) });
+
+    ++count;
+}
+
+void OrderIdTable::clear() noexcept
+{
+    Entries{}.swap(entries);
+    Entries{}.swap(old_entries);
+
+    count = 0;
+}
+
+void OrderIdTable::reserve(std::size_t count)
+{
+    std::size_t capacity = entries.empty() ? 16 : entries.size();
+
+    while(count * 8 > capacity * 7)
+    {
+        capacity *= 2;
+    }
+
+    if(capacity != entries.size())
+    {
+        rehash(capacity);
+    }
+}
+
+std::size_t OrderIdTable::shrink(std::size_t work)
+{
+    if(!shrinking())
+    {
+        if(entries.size() <= 16 || count * 8 >= entries.size())
+        {
+            return work;
+        }
+
+        std::size_t capacity = 16;
+
+        while(count * 2 > capacity)
+        {
+            capacity *= 2;
+        }
+
+        old_entries.swap(entries);
+        entries.assign(capacity, Entry{});
+
+        // Below 1/8 load an empty position is near.
+        next_to_move = 0;
+
+        while(none != old_entries[next_to_move].slot)
+        {
+            ++next_to_move;
+        }
+
+        moved = 0;
+    }
+
+    // Go on past the work to the end of a run of entries, see old_entries.
+    for(; moved < old_entries.size() && (work > 0 || none != old_entries[next_to_move].slot); ++moved, next_to_move = (next_to_move + 1) & mask(old_entries))
+    {
+        Entry& entry = old_entries[next_to_move];
+
+        if(none != entry.slot)
+        {
+            place(entries, entry);
+            entry = Entry{};
+        }
+
+        work -= std::min<std::size_t>(work, 1);
+    }
+
+    if(moved == old_entries.size())
+    {
+        Entries{}.swap(old_entries);
+    }
+
+    return work;
+}
+
+void OrderIdTable::relocate(std::string_view order_id, OrderSlot from, OrderSlot to) noexcept
+{
+    const std::uint32_t hash = hashOf(order_id);
+
+    if(const std::size_t pos = positionOf(entries, hash, from); pos != entries.size())
+    {
+        entries[pos].slot = to;
+    }
+    else if(const std::size_t old_pos = positionOf(old_entries, hash, from); old_pos != old_entries.size())
+    {
+        old_entries[old_pos].slot = to;
+    }
+}
+
+void OrderIdTable::erase(std::string_view order_id, OrderSlot slot) noexcept
+{
+    if(0 == count)
+    {
+        return;
+    }
+
+    const std::uint32_t hash = hashOf(order_id);
+
+    if(const std::size_t pos = positionOf(entries, hash, slot); pos != entries.size())
+    {
+        eraseAt(entries, pos);
+    }
+    else if(const std::size_t old_pos = positionOf(old_entries, hash, slot); old_pos != old_entries.size())
+    {
+        // The shift stays within the run of the entry, so the moved positions stay empty.
+        eraseAt(old_entries, old_pos);
+    }
+    else
+    {
+        return;
+    }
+
+    --count;
+}
+
+std::size_t OrderIdTable::positionOf(const Entries& table, std::uint32_t hash, OrderSlot slot) noexcept
+{
+    if(table.empty())
+    {
+        return table.size();
+    }
+
+    for(std::size_t pos = home(table, hash), dist = 0; ; pos = (pos + 1) & mask(table), ++dist)
+    {
+        const Entry& entry = table[pos];
+
+        if(none == entry.slot || distance(table, pos) < dist)
+        {
+            return table.size();
+        }
+
+        if(entry.slot == slot)
+        {
+            return pos;
+        }
+    }
+}
+
+std::uint32_t OrderIdTable::hashOf(std::string_view order_id) noexcept
+{
+    const std::size_t hash = std::hash<std::string_view>{}(order_id);
+
+    // Fold the high bits in so that they take part in the 32 bits kept.
+    return static_cast<std::uint32_t>(hash ^ (static_cast<std::uint64_t>(hash) >> 32));
+}
+
+void OrderIdTable::place(Entries& table, Entry entry) noexcept
+{
+    // Robin Hood: take the place of an entry closer to its home and carry that entry on.
+    for(std::size_t pos = home(table, entry.hash), dist = 0; ; pos = (pos + 1) & mask(table), ++dist)
+    {
+        if(none == table[pos].slot)
+        {
+            table[pos] = entry;
+            return;
+        }
+
+        if(const std::size_t entry_dist = distance(table, pos); entry_dist < dist)
+        {
+            std::swap(table[pos], entry);
+            dist = entry_dist;
+        }
+    }
+}
+
+void OrderIdTable::eraseAt(Entries& table, std::size_t pos) noexcept
+{
+    // Shift the following entries back until one is empty or already at its home.
+    for(std::size_t next = (pos + 1) & mask(table); none != table[next].slot && 0 != distance(table, next); next = (next + 1) & mask(table))
+    {
+        table[pos] = table[next];
+        pos = next;
+    }
+
+    table[pos] = Entry{};
+}
+
+void OrderIdTable::rehash(std::size_t capacity)
+{
+    Entries old_table(capacity);
+    old_table.swap(entries);
+
+    for(const Entry& entry : old_table)
+    {
+        if(none != entry.slot)
+        {
+            place(entries, entry);
+        }
+    }
+}
+
+void OrderIdTable::save(SnapshotWriter& writer) const
+{
+    writer.value(static_cast<std::uint64_t>(count));
+
+    if(!shrinking())
+    {
+        writer.array(entries);
+        return;
+    }
+
+    // The table grows counting the entries still to move, so they fit in.
+    Entries merged = entries;
+
+    for(const Entry& entry : old_entries)
+    {
+        if(none != entry.slot)
+        {
+            place(merged, entry);
+        }
+    }
+
+    writer.array(merged);
+}
+
+void OrderIdTable::load(SnapshotReader& reader)
+{
+    Entries{}.swap(old_entries);
+
+    count = static_cast<std::size_t>(reader.value<std::uint64_t>());
+    reader.array(entries);
+
+    // The probing relies on a power of two capacity.
+    if((entries.size() & (entries.size() - 1)) != 0 || count > entries.size())
+    {
+        throw std::runtime_error{ "snapshot has a bad order id table" };
+    }
+}
+
+void OrderIdTable::check(const OrderStore& store) const
+{
+    if(shrinking() || count != store.size() || count * 8 > entries.size() * 7)
+    {
+        throw std::runtime_error{ "snapshot has a bad order id table" };
+    }
+
+    std::vector<bool> seen(store.slotCount());
+    std::size_t entry_count = 0;
+
+    for(std::size_t pos = 0; pos < entries.size(); ++pos)
+    {
+        const Entry& entry = entries[pos];
+
+        if(none == entry.slot)
+        {
+            continue;
+        }
+
+        if(entry.slot >= store.slotCount() || !store.isLive(entry.slot) || seen[entry.slot] || entry.hash != hashOf(store.order_id[entry.slot]))
+        {
+            throw std::runtime_error{ "snapshot has a bad order id table" };
+        }
+
+        // A probe reaches the entry if every position before it, back to its home, holds an
+        // entry at least as far from its own home as the probe is there.
+        if(const std::size_t dist = distance(entries, pos); 0 != dist)
+        {
+            const std::size_t previous = (pos - 1) & mask(entries);
+
+            if(none == entries[previous].slot || distance(entries, previous) + 1 < dist)
+            {
+                throw std::runtime_error{ "snapshot has a bad order id table" };
+            }
+        }
+
+        seen[entry.slot] = true;
+        ++entry_count;
+    }
+
+    if(entry_count != count)
+    {
+        throw std::runtime_error{ "snapshot has a bad order id table" };
+    }
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include "OrderStore.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+// Maps order ids to order slots.
+// An open addressing hash table with Robin Hood probing. Entries hold the slot and 32 bits of
+// the id hash; the id itself is read from the order store only when the hash bits match.
+// Lookups, inserts and erases allocate nothing; only growing the table does.
+// Shrinking moves the entries into the smaller table a few at a time; until all are moved,
+// lookups probe both tables.
+class OrderIdTable
+{
+public:
+    static constexpr OrderSlot none = SymbolTable::none;
+
+    // return the slot of the order id or none if the id is not in the table
+    OrderSlot find(std::string_view order_id, const OrderStore& store) const noexcept;
+
+    // add an order id which is not in the table yet
+    void insert(std::string_view order_id, OrderSlot slot);
+
+    // remove an order id which is in the table with this slot
+    void erase(std::string_view order_id, OrderSlot slot) noexcept;
+
+    // remove every order id and free the table
+    void clear() noexcept;
+
+    // make room for count order ids without growing again
+    void reserve(std::size_t count);
+
+    // start moving the entries into the smallest capacity keeping the load factor at most 1/2,
+    // if it fell below 1/8, and move the entries of up to work positions of the old table
+    // Return the work left. The table only grows on insert, so this gives back the room of
+    // removed order ids once the last entry is moved.
+    std::size_t shrink(std::size_t work);
+
+    // return true while entries are left to move by shrink
+    bool shrinking() const noexcept { return !old_entries.empty(); }
+
+    // point the order id, which is in the table with slot from, to slot to
+    void relocate(std::string_view order_id, OrderSlot from, OrderSlot to) noexcept;
+
+    // return the number of order ids in the table
+    std::size_t size() const noexcept { return count; }
+
+    // return the number of entries the table has room for
+    std::size_t capacity() const noexcept { return entries.size(); }
+
+    // return the number of bytes held for the entries, of the old table too while shrinking
+    std::size_t memoryBytes() const noexcept { return (entries.capacity() + old_entries.capacity()) * sizeof(Entry); }
+
+    // write the entries to a snapshot
+    void save(SnapshotWriter& writer) const;
+
+    // replace the entries with the ones of a snapshot
+    void load(SnapshotReader& reader);
+
+    // throw std::runtime_error unless the table holds the live slots of the store, each once
+    // under the hash of its order id and where a lookup finds it
+    void check(const OrderStore& store) const;
+
+private:
+    struct Entry
+    {
+        OrderSlot slot = none;
+        std::uint32_t hash = 0;
+    };
+
+    using Entries = std::vector<Entry>;
+
+    Entries entries;
+
+    // The table being shrunk from, empty unless shrinking. Moving starts at an empty position
+    // and stops at empty ones only, so an entry left there keeps every position of its probe.
+    Entries old_entries;
+    std::size_t next_to_move = 0;
+    std::size_t moved = 0;
+
+    // Entries in both tables.
+    std::size_t count = 0;
+
+private:
+    static std::uint32_t hashOf(std::string_view order_id) noexcept;
+
+    static std::size_t mask(const Entries& table) noexcept { return table.size() - 1; }
+    static std::size_t home(const Entries& table, std::uint32_t hash) noexcept { return hash & mask(table); }
+
+    // How far the entry at the position is from its home position.
+    static std::size_t distance(const Entries& table, std::size_t pos) noexcept { return (pos - home(table, table[pos].hash)) & mask(table); }
+
+    static OrderSlot find(const Entries& table, std::uint32_t hash, std::string_view order_id, const OrderStore& store) noexcept;
+
+    // Return the position of the entry with this hash and slot, or the end of the table.
+    static std::size_t positionOf(const Entries& table, std::uint32_t hash, OrderSlot slot) noexcept;
+
+    static void place(Entries& table, Entry entry) noexcept;
+
+    // Empty the position, shifting the following entries back.
+    static void eraseAt(Entries& table, std::size_t pos) noexcept;
+
+    void rehash(std::size_t capacity);
+};
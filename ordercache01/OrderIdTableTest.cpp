@@ -0,0 +1,153 @@
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include "OrderIdTable.h"
+
+// Add an order with only its id set, the way OrderCache fills the store before inserting the id.
+static OrderSlot addOrderId(OrderStore& store, OrderIdTable& table, const std::string& order_id)
+{
+    const OrderSlot slot = store.allocate();
+
+    store.setOrderId(slot, order_id);
+    store.security[slot] = 0;
+
+    table.insert(order_id, slot);
+
+    return slot;
+}
+
+TEST(OrderIdTableTest, FindsInsertedOrderIds)
+{
+    OrderStore store;
+    OrderIdTable table;
+
+    for(int i = 0; i < 10000; ++i)
+    {
+        addOrderId(store, table, "OrdId" + std::to_string(i));
+    }
+
+    EXPECT_EQ(table.size(), 10000u);
+
+    for(int i = 0; i < 10000; ++i)
+    {
+        EXPECT_EQ(table.find("OrdId" + std::to_string(i), store), static_cast<OrderSlot>(i));
+    }
+
+    EXPECT_EQ(table.find("OrdId10000", store), OrderIdTable::none);
+    EXPECT_EQ(table.find("", store), OrderIdTable::none);
+}
+
+TEST(OrderIdTableTest, ErasesOrderIds)
+{
+    OrderStore store;
+    OrderIdTable table;
+
+    for(int i = 0; i < 5000; ++i)
+    {
+        addOrderId(store, table, "o" + std::to_string(i));
+    }
+
+    for(int i = 0; i < 5000; i += 3)
+    {
+        const std::string order_id = "o" + std::to_string(i);
+
+        table.erase(order_id, table.find(order_id, store));
+        store.release(static_cast<OrderSlot>(i));
+    }
+
+    for(int i = 0; i < 5000; ++i)
+    {
+        const OrderSlot slot = table.find("o" + std::to_string(i), store);
+
+        if(0 == i % 3)
+        {
+            EXPECT_EQ(slot, OrderIdTable::none) << i;
+        }
+        else
+        {
+            EXPECT_EQ(slot, static_cast<OrderSlot>(i)) << i;
+        }
+    }
+
+    EXPECT_EQ(table.size(), 3333u);
+
+    // Erasing an id which is not in the table changes nothing.
+    table.erase("o0", 0);
+    EXPECT_EQ(table.size(), 3333u);
+}
+
+TEST(OrderIdTableTest, FindsOrderIdsReinsertedIntoReusedSlots)
+{
+    OrderStore store;
+    OrderIdTable table;
+
+    const OrderSlot slot = addOrderId(store, table, "o1");
+
+    table.erase("o1", slot);
+    store.release(slot);
+
+    EXPECT_EQ(table.find("o1", store), OrderIdTable::none);
+
+    EXPECT_EQ(addOrderId(store, table, "o2"), slot);
+    EXPECT_EQ(table.find("o2", store), slot);
+    EXPECT_EQ(table.find("o1", store), OrderIdTable::none);
+}
+
+TEST(OrderIdTableTest, ShrinksIncrementallyOnceMostOrderIdsAreErased)
+{
+    OrderStore store;
+    OrderIdTable table;
+
+    for(int i = 0; i < 10000; ++i)
+    {
+        addOrderId(store, table, "o" + std::to_string(i));
+    }
+
+    const std::size_t capacity = table.capacity();
+
+    // Above 1/8 of the capacity the table keeps its room.
+    for(int i = 0; i < 7800; ++i)
+    {
+        table.erase("o" + std::to_string(i), static_cast<OrderSlot>(i));
+    }
+
+    EXPECT_EQ(table.shrink(100), 100u);
+    EXPECT_FALSE(table.shrinking());
+    EXPECT_EQ(table.capacity(), capacity);
+
+    for(int i = 7800; i < 9900; ++i)
+    {
+        table.erase("o" + std::to_string(i), static_cast<OrderSlot>(i));
+    }
+
+    // The entries move a few at a time; meanwhile the ids are found in either table.
+    table.shrink(100);
+    ASSERT_TRUE(table.shrinking());
+    EXPECT_EQ(table.capacity(), 256u);
+
+    table.erase("o9900", 9900);
+    table.relocate("o9950", 9950, 7);
+    store.setOrderId(7, "o9950");
+
+    for(int i = 9901; i < 10000; ++i)
+    {
+        EXPECT_EQ(table.find("o" + std::to_string(i), store), 9950 == i ? 7u : static_cast<OrderSlot>(i)) << i;
+    }
+
+    while(table.shrinking())
+    {
+        table.shrink(100);
+    }
+
+    EXPECT_EQ(table.capacity(), 256u);
+    EXPECT_EQ(table.size(), 99u);
+
+    for(int i = 9901; i < 10000; ++i)
+    {
+        EXPECT_EQ(table.find("o" + std::to_string(i), store), 9950 == i ? 7u : static_cast<OrderSlot>(i)) << i;
+    }
+
+    EXPECT_EQ(table.find("o9900", store), OrderIdTable::none);
+    EXPECT_EQ(table.find("o100", store), OrderIdTable::none);
+}
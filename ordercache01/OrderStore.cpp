@@ -0,0 +1,359 @@
+#include "OrderStore.h"
+#include "Snapshot.h"
+
+#include <algorithm>
+#include <iterator>
+
+OrderSlot OrderStore::allocate()
+{
+    ++live_count;
+
+    if(const OrderSlot slot = takeFreeSlot(); SymbolTable::none != slot)
+    {
+        return slot;
+    }
+
+    const auto slot = static_cast<OrderSlot>(order_id.size());
+
+    order_id.emplace_back();
+    qty.push_back(0);
+    side.push_back(Side::Buy);
+    security.push_back(SymbolTable::none);
+    user.push_back(SymbolTable::none);
+    company.push_back(SymbolTable::none);
+    security_pos.push_back(0);
+    user_pos.push_back(0);
+    company_pos.push_back(0);
+    security_rung.push_back(0);
+
+    return slot;
+}
+
+void OrderStore::release(OrderSlot slot)
+{
+    security[slot] = SymbolTable::none;
+
+    releaseOrderId(slot, order_id[slot]);
+    order_id[slot] = {};
+
+    free_slots.push_back(slot);
+
+    --live_count;
+}
+
+OrderSlot OrderStore::removeLastSlot()
+{
+    const auto last = static_cast<OrderSlot>(order_id.size() - 1);
+
+    OrderSlot to = SymbolTable::none;
+
+    if(isLive(last))
+    {
+        // The store is not dense, so a free slot below the last one is left.
+        to = takeFreeSlot();
+
+        order_id[to] = order_id[last];
+
+        // Keep the id in the arena of the slot while order ids are moved.
+        if(&arenaOf(to) != &arenaOf(last))
+        {
+            order_id[to] = arenaOf(to).store(order_id[last]);
+            releaseOrderId(last, order_id[last]);
+        }
+
+        qty[to] = qty[last];
+        side[to] = side[last];
+        security[to] = security[last];
+        user[to] = user[last];
+        company[to] = company[last];
+        security_pos[to] = security_pos[last];
+        user_pos[to] = user_pos[last];
+        company_pos[to] = company_pos[last];
+        security_rung[to] = security_rung[last];
+    }
+
+    // A free last slot stays in free_slots, past the end now, until taken and skipped.
+    order_id.pop_back();
+    qty.pop_back();
+    side.pop_back();
+    security.pop_back();
+    user.pop_back();
+    company.pop_back();
+    security_pos.pop_back();
+    user_pos.pop_back();
+    company_pos.pop_back();
+    security_rung.pop_back();
+
+    return to;
+}
+
+namespace
+{
+    template <typename T>
+    std::size_t shrinkToFit(std::vector<T>& column)
+    {
+        const std::size_t capacity = column.capacity();
+
+        column.shrink_to_fit();
+
+        return (capacity - column.capacity()) * sizeof(T);
+    }
+}
+
+std::size_t OrderStore::shrinkColumn(std::size_t column)
+{
+    switch(column)
+    {
+    case 0: return shrinkToFit(order_id);
+    case 1: return shrinkToFit(qty);
+    case 2: return shrinkToFit(side);
+    case 3: return shrinkToFit(security);
+    case 4: return shrinkToFit(user);
+    case 5: return shrinkToFit(company);
+    case 6: return shrinkToFit(security_pos);
+    case 7: return shrinkToFit(user_pos);
+    case 8: return shrinkToFit(company_pos);
+    case 9: return shrinkToFit(security_rung);
+    default: return 0;
+    }
+}
+
+std::size_t OrderStore::shrinkFreeSlots()
+{
+    if(!dense())
+    {
+        return 0;
+    }
+
+    // Every slot left in free_slots is past the end.
+    const std::size_t bytes = free_slots.capacity() * sizeof(OrderSlot);
+
+    std::vector<OrderSlot>{}.swap(free_slots);
+
+    return bytes;
+}
+
+std::size_t OrderStore::compactOrderIds(std::size_t work)
+{
+    if(!moving_ids)
+    {
+        if(order_ids.capacity() <= 2 * order_ids.usedBytes())
+        {
+            return work;
+        }
+
+        old_order_ids = std::move(order_ids);
+        ids_moved = 0;
+        moving_ids = true;
+    }
+
+    // The old arena and the loaded ids are freed as a whole, so the ids moved are not released from them.
+    for(; work > 0 && ids_moved < order_id.size(); --work, ++ids_moved)
+    {
+        order_id[ids_moved] = order_ids.store(order_id[ids_moved]);
+    }
+
+    // Slots may have been removed past ids_moved since the last call.
+    if(ids_moved >= order_id.size())
+    {
+        old_order_ids.clear();
+        std::vector<char>{}.swap(loaded_order_ids);
+        moving_ids = false;
+    }
+
+    return work;
+}
+
+std::size_t OrderStore::memoryBytes() const noexcept
+{
+    return order_id.capacity() * sizeof(std::string_view)
+        + qty.capacity() * sizeof(unsigned int)
+        + side.capacity() * sizeof(Side)
+        + (security.capacity() + user.capacity() + company.capacity()) * sizeof(SymbolId)
+        + (security_pos.capacity() + user_pos.capacity() + company_pos.capacity()) * sizeof(std::uint32_t)
+        + security_rung.capacity() * sizeof(std::uint16_t)
+        + free_slots.capacity() * sizeof(OrderSlot)
+        + orderIdBytes();
+}
+
+void OrderStore::releaseOrderId(OrderSlot slot, std::string_view id) noexcept
+{
+    const char* const loaded = loaded_order_ids.data();
+
+    if(id.data() >= loaded && id.data() < loaded + loaded_order_ids.size())
+    {
+        return;
+    }
+
+    arenaOf(slot).release(id);
+}
+
+OrderSlot OrderStore::takeFreeSlot() noexcept
+{
+    while(!free_slots.empty())
+    {
+        const OrderSlot slot = free_slots.back();
+        free_slots.pop_back();
+
+        if(slot < order_id.size())
+        {
+            return slot;
+        }
+    }
+
+    return SymbolTable::none;
+}
+
+void OrderStore::clear() noexcept
+{
+    order_id.clear();
+    qty.clear();
+    side.clear();
+    security.clear();
+    user.clear();
+    company.clear();
+    security_pos.clear();
+    user_pos.clear();
+    company_pos.clear();
+    security_rung.clear();
+
+    free_slots.clear();
+    order_ids.clear();
+    old_order_ids.clear();
+    std::vector<char>{}.swap(loaded_order_ids);
+    moving_ids = false;
+
+    live_count = 0;
+}
+
+void OrderStore::reserve(std::size_t count)
+{
+    // Free slots are reused before the columns grow.
+    const std::size_t slots = count > free_slots.size() ? order_id.size() + count - free_slots.size() : order_id.size();
+
+    order_id.reserve(slots);
+    qty.reserve(slots);
+    side.reserve(slots);
+    security.reserve(slots);
+    user.reserve(slots);
+    company.reserve(slots);
+    security_pos.reserve(slots);
+    user_pos.reserve(slots);
+    company_pos.reserve(slots);
+    security_rung.reserve(slots);
+}
+
+void OrderStore::save(SnapshotWriter& writer) const
+{
+    // Order ids as one block of characters and the offset where each id ends.
+    std::vector<std::uint64_t> order_id_ends;
+    std::vector<char> order_id_chars;
+
+    order_id_ends.reserve(order_id.size());
+
+    for(const std::string_view id : order_id)
+    {
+        order_id_chars.insert(order_id_chars.end(), id.begin(), id.end());
+        order_id_ends.push_back(order_id_chars.size());
+    }
+
+    writer.array(order_id_ends);
+    writer.array(order_id_chars);
+
+    writer.array(qty);
+    writer.array(side);
+    writer.array(security);
+    writer.array(user);
+    writer.array(company);
+    writer.array(security_pos);
+    writer.array(user_pos);
+    writer.array(company_pos);
+    writer.array(security_rung);
+
+    // Without the slots past the end left by compaction.
+    std::vector<OrderSlot> free;
+
+    std::copy_if(free_slots.begin(), free_slots.end(), std::back_inserter(free), [this](OrderSlot slot) { return slot < order_id.size(); });
+
+    writer.array(free);
+}
+
+void OrderStore::load(SnapshotReader& reader)
+{
+    std::vector<std::uint64_t> order_id_ends;
+
+    reader.array(order_id_ends);
+    reader.array(loaded_order_ids);
+
+    order_id.clear();
+    order_id.reserve(order_id_ends.size());
+    order_ids.clear();
+    old_order_ids.clear();
+
+    // The ids stay in the block they were read into, as if compactOrderIds were moving them out of it.
+    ids_moved = 0;
+    moving_ids = !loaded_order_ids.empty();
+
+    std::uint64_t begin = 0;
+
+    for(const std::uint64_t end : order_id_ends)
+    {
+        if(end < begin || end > loaded_order_ids.size())
+        {
+            throw std::runtime_error{ "snapshot has a bad order id" };
+        }
+
+        order_id.emplace_back(loaded_order_ids.data() + begin, static_cast<std::size_t>(end - begin));
+        begin = end;
+    }
+
+    reader.array(qty);
+    reader.array(side);
+
+    for(const Side s : side)
+    {
+        if(Side::Buy != s && Side::Sell != s)
+        {
+            throw std::runtime_error{ "snapshot has a bad order side" };
+        }
+    }
+
+    reader.array(security);
+    reader.array(user);
+    reader.array(company);
+    reader.array(security_pos);
+    reader.array(user_pos);
+    reader.array(company_pos);
+    reader.array(security_rung);
+
+    reader.array(free_slots);
+
+    for(const std::size_t column_size : { qty.size(), side.size(), security.size(), user.size(), company.size(),
+        security_pos.size(), user_pos.size(), company_pos.size(), security_rung.size() })
+    {
+        if(column_size != order_id.size())
+        {
+            throw std::runtime_error{ "snapshot has columns of different sizes" };
+        }
+    }
+
+    // Every slot without an order is free exactly once.
+    std::vector<bool> free(order_id.size());
+
+    for(const OrderSlot slot : free_slots)
+    {
+        if(slot >= order_id.size() || isLive(slot) || free[slot])
+        {
+            throw std::runtime_error{ "snapshot has a bad free slot" };
+        }
+
+        free[slot] = true;
+    }
+
+    if(static_cast<std::size_t>(std::count(security.begin(), security.end(), SymbolTable::none)) != free_slots.size())
+    {
+        throw std::runtime_error{ "snapshot has a bad free slot" };
+    }
+
+    live_count = order_id.size() - free_slots.size();
+}
@@ -0,0 +1,136 @@
+#pragma once
+
+#include "Side.h"
+#include "StringArena.h"
+#include "SymbolTable.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+using OrderSlot = std::uint32_t;
+
+// Orders stored column by column. An order lives in a slot, which is an index into every column.
+// Slots of removed orders are reused by the next orders added, so slots stay valid until released,
+// or until compaction moves the order, see removeLastSlot.
+// Order ids are kept in an arena, so adding and removing orders does not go to the heap once warm.
+// While compactOrderIds moves them into a new arena, the ids of the slots it has not reached yet
+// stay in the old one. A store loaded from a snapshot keeps the ids in the block read from it,
+// and compactOrderIds moves them out of that block the same way.
+class OrderStore
+{
+public:
+    using PositionColumn = std::vector<std::uint32_t>;
+
+    // return a free slot for a new order, growing the columns when none is left
+    OrderSlot allocate();
+
+    // mark the slot as free and give its order id back to the arena
+    void release(OrderSlot slot);
+
+    // copy the order id of the order in the slot into the arena
+    void setOrderId(OrderSlot slot, std::string_view id) { order_id[slot] = arenaOf(slot).store(id); }
+
+    // remove every order and free the order id arena
+    void clear() noexcept;
+
+    // make room for count orders without growing the columns again
+    void reserve(std::size_t count);
+
+    // remove the last slot, which must not leave the store dense already; if it holds an order,
+    // move the order into a free slot and return that slot, otherwise return none
+    // The caller points everything referring to the order at its new slot.
+    OrderSlot removeLastSlot();
+
+    // return true if every slot holds an order
+    bool dense() const noexcept { return live_count == order_id.size(); }
+
+    static constexpr std::size_t column_count = 10;
+
+    // give back the room of the column with this index, below column_count, beyond its size
+    // Return the number of bytes given back.
+    std::size_t shrinkColumn(std::size_t column);
+
+    // give back the room of the free slots if the store is dense, so that none is left
+    // Return the number of bytes given back.
+    std::size_t shrinkFreeSlots();
+
+    // start moving the order ids into a new arena if less than half of the arena holds them,
+    // and move the order ids of up to work slots; the old arena and the block of loaded ids are
+    // freed after the last slot
+    // Return the work left.
+    std::size_t compactOrderIds(std::size_t work);
+
+    // return true while order ids are left to move by compactOrderIds
+    bool compactingOrderIds() const noexcept { return moving_ids; }
+
+    // return the number of bytes held for the columns, the free slots and the order ids
+    std::size_t memoryBytes() const noexcept;
+
+    // write the columns and the free slots to a snapshot
+    void save(SnapshotWriter& writer) const;
+
+    // replace the columns and the free slots with the ones of a snapshot
+    void load(SnapshotReader& reader);
+
+    // return true if the slot holds an order
+    bool isLive(OrderSlot slot) const noexcept { return SymbolTable::none != security[slot]; }
+
+    // return the number of orders in the store
+    std::size_t size() const noexcept { return live_count; }
+
+    // return the number of slots, live or free
+    std::size_t slotCount() const noexcept { return order_id.size(); }
+
+    // return the number of bytes held for order ids
+    std::size_t orderIdBytes() const noexcept { return order_ids.capacity() + old_order_ids.capacity() + loaded_order_ids.capacity(); }
+
+    // Columns, indexed by slot.
+
+    // Views of order_ids, empty for a free slot.
+    std::vector<std::string_view> order_id;
+
+    std::vector<unsigned int> qty;
+    std::vector<Side>        side;
+
+    // None for a free slot.
+    std::vector<SymbolId> security;
+    std::vector<SymbolId>     user;
+    std::vector<SymbolId>  company;
+
+    // Positions of the order in the security, user and company index buckets.
+    // For the security index, the position in the rung of security_rung, see QtyLadder.
+    PositionColumn security_pos;
+    PositionColumn     user_pos;
+    PositionColumn  company_pos;
+
+    std::vector<std::uint16_t> security_rung;
+
+private:
+    // Slots past the last one, left by removeLastSlot, are skipped when taken; the columns
+    // only grow once none of them is left.
+    std::vector<OrderSlot> free_slots;
+
+    std::size_t live_count = 0;
+
+    StringArena order_ids;
+
+    // While moving order ids, the arena they move from holds the ids of the slots from ids_moved on,
+    // but for the ids still in the block of ids loaded from a snapshot.
+    StringArena old_order_ids;
+    std::size_t ids_moved = 0;
+    bool moving_ids = false;
+
+    // The order ids of a snapshot, one after another. Freed as a whole once compactOrderIds moved them.
+    std::vector<char> loaded_order_ids;
+
+private:
+    // Pop the last free slot which is not past the last slot, or return none if there is none.
+    OrderSlot takeFreeSlot() noexcept;
+
+    StringArena& arenaOf(OrderSlot slot) noexcept { return moving_ids && slot >= ids_moved ? old_order_ids : order_ids; }
+
+    // Give the id of the order in the slot back to its arena, unless it is a loaded id.
+    void releaseOrderId(OrderSlot slot, std::string_view id) noexcept;
+};
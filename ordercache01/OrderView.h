@@ -0,0 +1,33 @@
+#pragma once
+
+#include "OrderCacheInterface.h"
+
+#include <cstddef>
+#include <limits>
+#include <string>
+#include <string_view>
+
+// An order seen in place in a cache, without copying its fields.
+// The fields refer to memory of the cache and are valid until the cache next changes.
+struct OrderView
+{
+    std::string_view order_id;
+    std::string_view security_id;
+    std::string_view side;
+    unsigned int qty = 0;
+    std::string_view user;
+    std::string_view company;
+
+    // return a copy of the order that outlives the cache
+    Order toOrder() const
+    {
+        return { std::string{ order_id }, std::string{ security_id }, std::string{ side }, qty, std::string{ user }, std::string{ company } };
+    }
+};
+
+// Where a walk over orders stopped, to resume it from there.
+// Walks start from 0 and return order_cursor_end once every order was visited.
+// Orders added or removed between two pages may be missed or visited twice.
+using OrderCursor = std::size_t;
+
+constexpr OrderCursor order_cursor_end = std::numeric_limits<OrderCursor>::max();
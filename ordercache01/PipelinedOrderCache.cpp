@@ -0,0 +1,465 @@
+#include "PipelinedOrderCache.h"
+
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+
+namespace
+{
+    // Set the promise to the result of query, or to the exception it throws, and delete it.
+    template <typename T, typename Query>
+    void settle(std::promise<T>* result, Query query)
+    {
+        const std::unique_ptr<std::promise<T>> promise{ result };
+
+        try
+        {
+            if constexpr(std::is_void_v<T>)
+            {
+                query();
+                promise->set_value();
+            }
+            else
+            {
+                promise->set_value(query());
+            }
+        }
+        catch(...)
+        {
+            promise->set_exception(std::current_exception());
+        }
+    }
+
+    // Set the promise to the error and delete it.
+    template <typename T>
+    void abandon(void* result, const std::exception_ptr& error)
+    {
+        const std::unique_ptr<std::promise<T>> promise{ static_cast<std::promise<T>*>(result) };
+
+        promise->set_exception(error);
+    }
+
+    std::exception_ptr stoppedError()
+    {
+        return std::make_exception_ptr(std::runtime_error{ "pipelined order cache is stopped" });
+    }
+}
+
+PipelinedOrderCache::PipelinedOrderCache(std::size_t ring_capacity, std::size_t batch_size) :
+    batch_size{ batch_size ? batch_size : 1 },
+    ring{ ring_capacity }
+{
+    owner = std::thread{ [this] { ownerLoop(); } };
+}
+
+PipelinedOrderCache::~PipelinedOrderCache()
+{
+    stop();
+}
+
+void PipelinedOrderCache::addOrder(Order order)
+{
+    Command command;
+
+    command.kind = Command::Kind::Add;
+    command.qty = order.qty();
+
+    setText(command, { order.orderId(), order.securityId(), order.side(), order.user(), order.company() });
+
+    post(command);
+}
+
+void PipelinedOrderCache::cancelOrder(const std::string& orderId)
+{
+    Command command;
+
+    command.kind = Command::Kind::Cancel;
+    setText(command, { orderId });
+
+    post(command);
+}
+
+void PipelinedOrderCache::cancelOrdersForUser(const std::string& user)
+{
+    Command command;
+
+    command.kind = Command::Kind::CancelUser;
+    setText(command, { user });
+
+    post(command);
+}
+
+void PipelinedOrderCache::cancelOrdersForSecIdWithMinimumQty(const std::string& securityId, unsigned int minQty)
+{
+    Command command;
+
+    command.kind = Command::Kind::CancelSecurityMinQty;
+    command.qty = minQty;
+    setText(command, { securityId });
+
+    post(command);
+}
+
+unsigned int PipelinedOrderCache::getMatchingSizeForSecurity(const std::string& securityId)
+{
+    return postMatchingSizeForSecurity(securityId).get();
+}
+
+std::vector<Order> PipelinedOrderCache::getAllOrders() const
+{
+    return postAllOrders().get();
+}
+
+std::future<unsigned int> PipelinedOrderCache::postMatchingSizeForSecurity(const std::string& securityId) const
+{
+    Command command;
+
+    command.kind = Command::Kind::MatchingSize;
+    setText(command, { securityId });
+
+    auto* promise = new std::promise<unsigned int>;
+    command.result = promise;
+
+    std::future<unsigned int> result = promise->get_future();
+
+    post(command);
+
+    return result;
+}
+
+std::future<std::vector<Order>> PipelinedOrderCache::postAllOrders() const
+{
+    Command command;
+
+    command.kind = Command::Kind::AllOrders;
+
+    auto* promise = new std::promise<std::vector<Order>>;
+    command.result = promise;
+
+    std::future<std::vector<Order>> result = promise->get_future();
+
+    post(command);
+
+    return result;
+}
+
+void PipelinedOrderCache::flush() const
+{
+    Command command;
+
+    command.kind = Command::Kind::Flush;
+
+    auto* promise = new std::promise<void>;
+    command.result = promise;
+
+    std::future<void> result = promise->get_future();
+
+    post(command);
+
+    result.get();
+}
+
+void PipelinedOrderCache::stop()
+{
+    if(stopped.exchange(true))
+    {
+        return;
+    }
+
+    while(posting.load() > 0)
+    {
+        std::this_thread::yield();
+    }
+
+    // Commands are applied in order, so everything posted before Stop is applied.
+    push(Command{});
+    owner.join();
+
+    // Nothing can be posted after Stop; fail whatever is left all the same rather than leak it.
+    const std::exception_ptr error = stoppedError();
+
+    for(Command command; ring.tryPop(command); )
+    {
+        fail(command, error);
+    }
+}
+
+void PipelinedOrderCache::setText(Command& command, std::initializer_list<std::string_view> fields)
+{
+    std::size_t size = 0;
+    std::size_t index = 0;
+
+    for(const std::string_view field : fields)
+    {
+        command.lengths[index++] = static_cast<std::uint32_t>(field.size());
+        size += field.size();
+    }
+
+    char* text = command.text;
+
+    if(size > inline_text)
+    {
+        command.long_text = new std::string(size, '\0');
+        text = command.long_text->data();
+    }
+
+    for(const std::string_view field : fields)
+    {
+        std::memcpy(text, field.data(), field.size());
+        text += field.size();
+    }
+}
+
+std::string_view PipelinedOrderCache::field(const Command& command, std::size_t index) noexcept
+{
+    const char* text = command.long_text ? command.long_text->data() : command.text;
+
+    for(std::size_t i = 0; i < index; ++i)
+    {
+        text += command.lengths[i];
+    }
+
+    return { text, command.lengths[index] };
+}
+
+void PipelinedOrderCache::post(Command command) const
+{
+    posting.fetch_add(1);
+
+    if(stopped.load())
+    {
+        posting.fetch_sub(1);
+
+        const std::exception_ptr error = stoppedError();
+        fail(command, error);
+        std::rethrow_exception(error);
+    }
+
+    push(command);
+
+    posting.fetch_sub(1, std::memory_order_release);
+}
+
+void PipelinedOrderCache::push(Command command) const
+{
+    while(!ring.tryPush(std::move(command)))
+    {
+        std::this_thread::yield();
+    }
+
+    // Pairs with the fence in waitForCommands: either the owner sees the command before it
+    // sleeps, or this thread sees it sleeping and wakes it.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    if(owner_sleeping.load(std::memory_order_relaxed))
+    {
+        std::lock_guard<std::mutex> lock{ wake_mutex };
+        commands_ready.notify_one();
+    }
+}
+
+void PipelinedOrderCache::fail(Command& command, const std::exception_ptr& error)
+{
+    using Kind = Command::Kind;
+
+    delete command.long_text;
+    command.long_text = nullptr;
+
+    switch(command.kind)
+    {
+    case Kind::MatchingSize:
+        abandon<unsigned int>(command.result, error);
+        break;
+
+    case Kind::AllOrders:
+        abandon<std::vector<Order>>(command.result, error);
+        break;
+
+    case Kind::Flush:
+        abandon<void>(command.result, error);
+        break;
+
+    default:
+        break;
+    }
+
+    command.result = nullptr;
+}
+
+void PipelinedOrderCache::ownerLoop()
+{
+    std::vector<Command> batch;
+    batch.reserve(batch_size);
+
+    for(Command command; ; )
+    {
+        while(batch.size() < batch_size && ring.tryPop(command))
+        {
+            batch.push_back(command);
+        }
+
+        if(batch.empty())
+        {
+            waitForCommands();
+            continue;
+        }
+
+        const bool stop = apply(batch);
+
+        batch.clear();
+
+        if(stop)
+        {
+            return;
+        }
+    }
+}
+
+void PipelinedOrderCache::waitForCommands()
+{
+    for(int spin = 0; spin < idle_spins; ++spin)
+    {
+        if(!ring.empty())
+        {
+            return;
+        }
+
+        std::this_thread::yield();
+    }
+
+    std::unique_lock<std::mutex> lock{ wake_mutex };
+
+    owner_sleeping.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    commands_ready.wait(lock, [this] { return !ring.empty(); });
+
+    owner_sleeping.store(false, std::memory_order_relaxed);
+}
+
+bool PipelinedOrderCache::apply(std::vector<Command>& batch)
+{
+    using Kind = Command::Kind;
+
+    bool stop = false;
+
+    for(std::size_t first = 0; first < batch.size(); )
+    {
+        const Kind kind = batch[first].kind;
+
+        // Consecutive adds, and consecutive cancels, are applied at once.
+        std::size_t last = first + 1;
+
+        if(Kind::Add == kind || Kind::Cancel == kind)
+        {
+            while(last < batch.size() && kind == batch[last].kind)
+            {
+                ++last;
+            }
+        }
+
+        // Queries settle their own exceptions; those of mutations wait for the next flush.
+        try
+        {
+            applyRun(batch, first, last);
+        }
+        catch(...)
+        {
+            if(!failure)
+            {
+                failure = std::current_exception();
+            }
+        }
+
+        stop = stop || Kind::Stop == kind;
+        first = last;
+    }
+
+    for(Command& command : batch)
+    {
+        delete command.long_text;
+    }
+
+    return stop;
+}
+
+void PipelinedOrderCache::applyRun(std::vector<Command>& batch, std::size_t first, std::size_t last)
+{
+    using Kind = Command::Kind;
+
+    Command& command = batch[first];
+
+    switch(command.kind)
+    {
+    case Kind::Add:
+        adds.clear();
+
+        for(std::size_t i = first; i < last; ++i)
+        {
+            const Command& add = batch[i];
+
+            adds.emplace_back(std::string{ field(add, 0) }, std::string{ field(add, 1) }, std::string{ field(add, 2) },
+                add.qty, std::string{ field(add, 3) }, std::string{ field(add, 4) });
+        }
+
+        if(1 == adds.size())
+        {
+            cache.addOrder(std::move(adds.front()));
+        }
+        else
+        {
+            cache.addOrders(adds);
+        }
+
+        break;
+
+    case Kind::Cancel:
+        cancels.clear();
+
+        for(std::size_t i = first; i < last; ++i)
+        {
+            cancels.push_back(field(batch[i], 0));
+        }
+
+        if(1 == cancels.size())
+        {
+            cache.cancelOrder(std::string{ cancels.front() });
+        }
+        else
+        {
+            cache.cancelOrders(cancels);
+        }
+
+        break;
+
+    case Kind::CancelUser:
+        cache.cancelOrdersForUser(std::string{ field(command, 0) });
+        break;
+
+    case Kind::CancelSecurityMinQty:
+        cache.cancelOrdersForSecIdWithMinimumQty(std::string{ field(command, 0) }, command.qty);
+        break;
+
+    case Kind::MatchingSize:
+        settle(static_cast<std::promise<unsigned int>*>(command.result), [&] { return cache.getMatchingSizeForSecurity(std::string{ field(command, 0) }); });
+        break;
+
+    case Kind::AllOrders:
+        settle(static_cast<std::promise<std::vector<Order>>*>(command.result), [&] { return cache.getAllOrders(); });
+        break;
+
+    case Kind::Flush:
+        settle(static_cast<std::promise<void>*>(command.result), [this]
+        {
+            if(failure)
+            {
+                std::rethrow_exception(std::exchange(failure, nullptr));
+            }
+        });
+        break;
+
+    case Kind::Stop:
+        break;
+    }
+}
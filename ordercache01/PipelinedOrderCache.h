@@ -0,0 +1,172 @@
+#pragma once
+
+#include "MpscRing.h"
+#include "OrderCache.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <future>
+#include <initializer_list>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// An OrderCacheInterface safe to use from many threads at once, where a single owner thread
+// applies every call to an OrderCache. Producer threads post commands into a lock-free ring;
+// the owner takes them in batches, in the order they were posted, so the cache itself needs
+// no lock. Consecutive adds and cancels of a batch are applied with addOrders and
+// cancelOrders.
+//
+// Mutations return once posted. Queries return a future, or wait for it in the
+// OrderCacheInterface methods; a query sees every command its thread posted before it.
+// A full ring makes producers wait for room. An exception thrown by a mutation does not stop
+// the owner: the next flush throws it.
+class PipelinedOrderCache : public OrderCacheInterface
+{
+public:
+    explicit PipelinedOrderCache(std::size_t ring_capacity = 16384, std::size_t batch_size = 256);
+
+    // stop the cache, if not stopped yet
+    ~PipelinedOrderCache();
+
+    PipelinedOrderCache(const PipelinedOrderCache&) = delete;
+    PipelinedOrderCache& operator = (const PipelinedOrderCache&) = delete;
+
+    // add order to the cache
+    void addOrder(Order order) override;
+
+    // remove order with this unique order id from the cache
+    void cancelOrder(const std::string& orderId) override;
+
+    // remove all orders in the cache for this user
+    void cancelOrdersForUser(const std::string& user) override;
+
+    // remove all orders in the cache for this security with qty >= minQty
+    void cancelOrdersForSecIdWithMinimumQty(const std::string& securityId, unsigned int minQty) override;
+
+    // return the total qty that can match for the security id
+    unsigned int getMatchingSizeForSecurity(const std::string& securityId) override;
+
+    // return all orders in cache in a vector
+    std::vector<Order> getAllOrders() const override;
+
+    // return the future total qty that can match for the security id
+    std::future<unsigned int> postMatchingSizeForSecurity(const std::string& securityId) const;
+
+    // return the future orders in cache
+    std::future<std::vector<Order>> postAllOrders() const;
+
+    // wait until every command posted so far, by any thread, is applied
+    // Throw the first exception a mutation threw since the last flush.
+    void flush() const;
+
+    // apply every command posted so far, then stop the owner thread
+    // Commands posted from then on throw std::runtime_error. Does nothing if already stopped.
+    void stop();
+
+private:
+    // Bytes of text a command holds inline; longer text goes to the heap.
+    static constexpr std::size_t inline_text = 72;
+
+    // A call posted to the owner thread.
+    // Trivially copyable and of fixed size, so that posting one copies 120 bytes into the ring
+    // and goes to the heap only for text longer than inline_text and for the promise of a query.
+    struct Command
+    {
+        enum class Kind : unsigned char
+        {
+            Add,
+            Cancel,
+            CancelUser,
+            CancelSecurityMinQty,
+            MatchingSize,
+            AllOrders,
+            Flush,
+            Stop,
+        };
+
+        static constexpr std::size_t max_fields = 5;
+
+        Kind kind = Kind::Stop;
+
+        // Lengths of the fields one after the other in the text: order id, security id, side,
+        // user and company of an add, else the order id, user or security id.
+        std::uint32_t lengths[max_fields] = {};
+
+        // Qty of an add, minimum qty of a cancel by security.
+        unsigned int qty = 0;
+
+        // The text if longer than inline_text, else null; deleted by the owner, or by stop if left in the ring.
+        std::string* long_text = nullptr;
+
+        // The std::promise of a query, of the type of its kind; set and deleted by the owner, or failed by stop.
+        void* result = nullptr;
+
+        char text[inline_text];
+    };
+
+    static_assert(std::is_trivially_copyable_v<Command>);
+
+    // set the text of the command to the fields
+    static void setText(Command& command, std::initializer_list<std::string_view> fields);
+
+    // return the field with this index in the text of the command
+    static std::string_view field(const Command& command, std::size_t index) noexcept;
+
+    // Rounds the owner checks the ring for commands before it goes to sleep.
+    static constexpr int idle_spins = 64;
+
+    // push the command, unless the cache is stopped
+    // Throw std::runtime_error, after failing the command, if it is.
+    void post(Command command) const;
+
+    // copy the command into the ring, waiting for room, and wake the owner if it sleeps
+    void push(Command command) const;
+
+    // free the text of the command and set its promise, if any, to the error
+    static void fail(Command& command, const std::exception_ptr& error);
+
+    void ownerLoop();
+
+    // wait until the ring has a command
+    void waitForCommands();
+
+    // apply the commands, free their text and return true if one of them is Stop
+    bool apply(std::vector<Command>& batch);
+
+    // apply the commands of the batch from first to last, all of one kind if more than one
+    void applyRun(std::vector<Command>& batch, std::size_t first, std::size_t last);
+
+    const std::size_t batch_size;
+
+    mutable MpscRing<Command> ring;
+
+    // The owner sets owner_sleeping and waits on commands_ready under wake_mutex; producers
+    // which find it set after posting notify it.
+    mutable std::mutex wake_mutex;
+    mutable std::condition_variable commands_ready;
+    mutable std::atomic<bool> owner_sleeping{ false };
+
+    // Set by stop before it posts Stop, which waits for the producers counted in posting to
+    // finish: each either sees stopped or has its command in the ring ahead of Stop.
+    std::atomic<bool> stopped{ false };
+    mutable std::atomic<std::size_t> posting{ 0 };
+
+    // Only touched by the owner thread.
+    OrderCache cache;
+
+    // The first exception a mutation threw since the last Flush; only touched by the owner thread.
+    std::exception_ptr failure;
+
+    // Scratch runs of commands of a batch applied at once.
+    std::vector<Order> adds;
+    std::vector<std::string_view> cancels;
+
+    std::thread owner;
+};
@@ -0,0 +1,232 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <future>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "MpscRing.h"
+#include "OrderCacheTestHelpers.h"
+#include "PipelinedOrderCache.h"
+
+TEST(PipelinedOrderCacheTest, BehavesLikeOrderCacheSingleThreaded)
+{
+    // A small ring and batch make the producer wait for room and the owner take many batches.
+    PipelinedOrderCache pipelined{ 64, 16 };
+    OrderCache cache;
+
+    for(const auto& op : makeOperations(0, 5000))
+    {
+        apply(pipelined, op);
+        apply(cache, op);
+    }
+
+    EXPECT_EQ(sortedFields(pipelined.getAllOrders()), sortedFields(cache.getAllOrders()));
+
+    for(int s = 0; s < 40; ++s)
+    {
+        const std::string security = "s" + std::to_string(s);
+        EXPECT_EQ(pipelined.getMatchingSizeForSecurity(security), cache.getMatchingSizeForSecurity(security)) << security;
+    }
+}
+
+TEST(PipelinedOrderCacheTest, AnswersQueriesThroughFutures)
+{
+    PipelinedOrderCache cache;
+
+    cache.addOrder({ "o1", "s1", "Buy", 300, "u1", "c1" });
+    cache.addOrder({ "o2", "s1", "Sell", 200, "u2", "c2" });
+
+    std::future<unsigned int> matching = cache.postMatchingSizeForSecurity("s1");
+
+    cache.cancelOrder("o2");
+
+    std::future<std::vector<Order>> orders = cache.postAllOrders();
+
+    // Each query sees the commands posted before it and none after.
+    EXPECT_EQ(matching.get(), 200u);
+    EXPECT_EQ(orders.get().size(), 1u);
+
+    // Invalid orders are rejected by the owner and leave the pipeline running.
+    cache.addOrder({ "o3", "s1", "Hold", 100, "u3", "c3" });
+    cache.flush();
+
+    EXPECT_EQ(cache.getAllOrders().size(), 1u);
+}
+
+TEST(PipelinedOrderCacheTest, CarriesNamesLongerThanACommand)
+{
+    PipelinedOrderCache cache{ 4, 2 };
+
+    const std::string security(200, 's');
+    const std::string user(100, 'u');
+
+    cache.addOrder({ std::string(300, 'o'), security, "Buy", 300, user, std::string(50, 'c') });
+    cache.addOrder({ "o2", security, "Sell", 200, "u2", "c2" });
+
+    EXPECT_EQ(cache.getMatchingSizeForSecurity(security), 200u);
+
+    cache.cancelOrder(std::string(300, 'o'));
+    EXPECT_EQ(cache.getMatchingSizeForSecurity(security), 0u);
+
+    cache.addOrder({ "o3", security, "Buy", 500, user, "c3" });
+    cache.cancelOrdersForUser(user);
+    cache.cancelOrdersForSecIdWithMinimumQty(security, 300);
+    cache.addOrder({ "o4", security, "Buy", 100, "u4", "c4" });
+
+    const std::vector<Order> orders = cache.getAllOrders();
+
+    ASSERT_EQ(orders.size(), 2u);
+    EXPECT_EQ(sortedFields(orders).front(), OrderFields("o2", security, "Sell", 200, "u2", "c2"));
+}
+
+TEST(PipelinedOrderCacheTest, MatchesSingleThreadedReplayUnderConcurrentProducers)
+{
+    constexpr int producers = 8;
+    constexpr int operations = 10000;
+
+    PipelinedOrderCache pipelined{ 256 };
+
+    std::vector<std::thread> threads;
+
+    for(int p = 0; p < producers; ++p)
+    {
+        threads.emplace_back([&, p]
+        {
+            for(const auto& op : makeOperations(p, operations))
+            {
+                apply(pipelined, op);
+            }
+        });
+    }
+
+    for(auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    pipelined.flush();
+
+    OrderCache cache;
+
+    for(int p = 0; p < producers; ++p)
+    {
+        for(const auto& op : makeOperations(p, operations))
+        {
+            apply(cache, op);
+        }
+    }
+
+    EXPECT_EQ(sortedFields(pipelined.getAllOrders()), sortedFields(cache.getAllOrders()));
+}
+
+TEST(PipelinedOrderCacheTest, SettlesEveryQueryPostedAroundStop)
+{
+    constexpr int producers = 4;
+
+    PipelinedOrderCache cache{ 64, 8 };
+
+    std::vector<std::thread> threads;
+    std::vector<std::vector<std::future<unsigned int>>> queries(producers);
+
+    for(int p = 0; p < producers; ++p)
+    {
+        threads.emplace_back([&, p]
+        {
+            // Names longer than a command go to the heap, and must not leak either.
+            const std::string security = std::string(100, 's') + std::to_string(p);
+
+            try
+            {
+                for(int i = 0; ; ++i)
+                {
+                    cache.addOrder({ "o" + std::to_string(p) + "-" + std::to_string(i), security, "Buy", 1, "u", "c" });
+                    queries[p].push_back(cache.postMatchingSizeForSecurity(security));
+                }
+            }
+            catch(const std::runtime_error&)
+            {
+            }
+        });
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds{ 10 });
+
+    cache.stop();
+
+    for(auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    std::size_t answered = 0;
+
+    // Every query got in before stop, so it is answered.
+    for(auto& producer_queries : queries)
+    {
+        for(auto& query : producer_queries)
+        {
+            EXPECT_NO_THROW(query.get());
+            ++answered;
+        }
+    }
+
+    EXPECT_GT(answered, 0u);
+
+    EXPECT_THROW(cache.addOrder({ "o", "s", "Buy", 1, "u", "c" }), std::runtime_error);
+    EXPECT_THROW(cache.getMatchingSizeForSecurity("s"), std::runtime_error);
+
+    cache.stop();
+}
+
+TEST(MpscRingTest, DeliversEveryValueOnceInProducerOrder)
+{
+    constexpr int producers = 4;
+    constexpr int values = 50000;
+
+    MpscRing<int> ring{ 100 };
+
+    EXPECT_EQ(ring.capacity(), 128u);
+    EXPECT_TRUE(ring.empty());
+
+    std::vector<std::thread> threads;
+
+    for(int p = 0; p < producers; ++p)
+    {
+        threads.emplace_back([&, p]
+        {
+            for(int i = 0; i < values; ++i)
+            {
+                while(!ring.tryPush(p * values + i))
+                {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+
+    // The values of each producer must come out in the order it pushed them.
+    std::vector<int> next(producers, 0);
+
+    for(int received = 0, value; received < producers * values; )
+    {
+        if(!ring.tryPop(value))
+        {
+            std::this_thread::yield();
+            continue;
+        }
+
+        ASSERT_EQ(value % values, next[value / values]++);
+        ++received;
+    }
+
+    for(auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    EXPECT_TRUE(ring.empty());
+    EXPECT_EQ(next, std::vector<int>(producers, values));
+}
@@ -0,0 +1,133 @@
+#include "QtyFilter.h"
+
+#include <algorithm>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define ORDERCACHE_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+namespace
+{
+    using QtyFilterFunction = std::size_t (*)(const unsigned int*, std::size_t, unsigned int, std::uint64_t*);
+
+    // Finish the quantities after the last full block one by one.
+    std::size_t selectTail(const unsigned int* qty, std::size_t begin, std::size_t count, unsigned int min_qty, std::uint64_t* mask)
+    {
+        std::size_t selected = 0;
+
+        for(std::size_t i = begin; i < count; ++i)
+        {
+            if(qty[i] >= min_qty)
+            {
+                mask[i / 64] |= std::uint64_t{ 1 } << (i % 64);
+                ++selected;
+            }
+        }
+
+        return selected;
+    }
+
+#ifdef ORDERCACHE_X86_SIMD
+
+    // qty >= min_qty for unsigned values is max(qty, min_qty) == qty.
+
+    __attribute__((target("sse4.1")))
+    std::size_t selectQtyAtLeastSse41(const unsigned int* qty, std::size_t count, unsigned int min_qty, std::uint64_t* mask)
+    {
+        std::fill_n(mask, qtyMaskWords(count), std::uint64_t{ 0 });
+
+        const __m128i min = _mm_set1_epi32(static_cast<int>(min_qty));
+
+        std::size_t selected = 0;
+        std::size_t i = 0;
+
+        for(; i + 4 <= count; i += 4)
+        {
+            const __m128i values = _mm_loadu_si128(reinterpret_cast<const __m128i*>(qty + i));
+            const __m128i at_least = _mm_cmpeq_epi32(_mm_max_epu32(values, min), values);
+
+            const auto bits = static_cast<std::uint64_t>(_mm_movemask_ps(_mm_castsi128_ps(at_least)));
+
+            mask[i / 64] |= bits << (i % 64);
+            selected += static_cast<std::size_t>(__builtin_popcountll(bits));
+        }
+
+        return selected + selectTail(qty, i, count, min_qty, mask);
+    }
+
+    __attribute__((target("avx2")))
+    std::size_t selectQtyAtLeastAvx2(const unsigned int* qty, std::size_t count, unsigned int min_qty, std::uint64_t* mask)
+    {
+        std::fill_n(mask, qtyMaskWords(count), std::uint64_t{ 0 });
+
+        const __m256i min = _mm256_set1_epi32(static_cast<int>(min_qty));
+
+        std::size_t selected = 0;
+        std::size_t i = 0;
+
+        for(; i + 8 <= count; i += 8)
+        {
+            const __m256i values = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(qty + i));
+            const __m256i at_least = _mm256_cmpeq_epi32(_mm256_max_epu32(values, min), values);
+
+            const auto bits = static_cast<std::uint64_t>(_mm256_movemask_ps(_mm256_castsi256_ps(at_least)));
+
+            mask[i / 64] |= bits << (i % 64);
+            selected += static_cast<std::size_t>(__builtin_popcountll(bits));
+        }
+
+        return selected + selectTail(qty, i, count, min_qty, mask);
+    }
+
+#endif
+
+    struct QtyFilter
+    {
+        QtyFilterFunction function;
+        const char* name;
+    };
+
+    QtyFilter pickQtyFilter()
+    {
+#ifdef ORDERCACHE_X86_SIMD
+        __builtin_cpu_init();
+
+        if(__builtin_cpu_supports("avx2"))
+        {
+            return { selectQtyAtLeastAvx2, "avx2" };
+        }
+
+        if(__builtin_cpu_supports("sse4.1"))
+        {
+            return { selectQtyAtLeastSse41, "sse4.1" };
+        }
+#endif
+
+        return { selectQtyAtLeastScalar, "scalar" };
+    }
+
+    const QtyFilter& qtyFilter()
+    {
+        static const QtyFilter filter = pickQtyFilter();
+
+        return filter;
+    }
+}
+
+std::size_t selectQtyAtLeast(const unsigned int* qty, std::size_t count, unsigned int min_qty, std::uint64_t* mask)
+{
+    return qtyFilter().function(qty, count, min_qty, mask);
+}
+
+std::size_t selectQtyAtLeastScalar(const unsigned int* qty, std::size_t count, unsigned int min_qty, std::uint64_t* mask)
+{
+    std::fill_n(mask, qtyMaskWords(count), std::uint64_t{ 0 });
+
+    return selectTail(qty, 0, count, min_qty, mask);
+}
+
+const char* qtyFilterImplementation()
+{
+    return qtyFilter().name;
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include "Bits.h"
+
+#include <cstddef>
+#include <cstdint>
+
+// Number of 64-bit mask words needed for count quantities.
+constexpr std::size_t qtyMaskWords(std::size_t count) noexcept { return (count + 63) / 64; }
+
+// Set bit i of the mask for every qty[i] >= min_qty and clear the other bits.
+// The mask must hold qtyMaskWords(count) words. Return the number of bits set.
+// Uses the widest SIMD instruction set supported by the CPU, picked once at runtime.
+std::size_t selectQtyAtLeast(const unsigned int* qty, std::size_t count, unsigned int min_qty, std::uint64_t* mask);
+
+// The portable implementation of selectQtyAtLeast.
+std::size_t selectQtyAtLeastScalar(const unsigned int* qty, std::size_t count, unsigned int min_qty, std::uint64_t* mask);
+
+// return the name of the implementation picked by selectQtyAtLeast: "avx2", "sse4.1" or "scalar"
+const char* qtyFilterImplementation();
@@ -0,0 +1,43 @@
+#include <gtest/gtest.h>
+
+#include <random>
+#include <vector>
+
+#include "QtyFilter.h"
+
+TEST(QtyFilterTest, SelectsQtyAtLeastMinimum)
+{
+    const std::vector<unsigned int> qty{ 100, 200, 199, 0, 4000000000u, 200, 1, 300, 50 };
+
+    std::vector<std::uint64_t> mask(qtyMaskWords(qty.size()));
+
+    EXPECT_EQ(selectQtyAtLeast(qty.data(), qty.size(), 200, mask.data()), 4u);
+    EXPECT_EQ(mask[0], 0b010110010u);
+}
+
+TEST(QtyFilterTest, MatchesScalarImplementation)
+{
+    std::mt19937 rng{ 7 };
+    std::uniform_int_distribution<unsigned int> qty_dist{ 0, 0xFFFFFFFFu };
+
+    for(const std::size_t count : { 0, 1, 3, 4, 7, 8, 9, 63, 64, 65, 130, 1000 })
+    {
+        std::vector<unsigned int> qty(count);
+
+        for(auto& q : qty)
+        {
+            q = qty_dist(rng);
+        }
+
+        const unsigned int min_qty = count ? qty[count / 2] : 0;
+
+        std::vector<std::uint64_t> mask(qtyMaskWords(count), ~std::uint64_t{ 0 });
+        std::vector<std::uint64_t> expected_mask(qtyMaskWords(count));
+
+        const auto selected = selectQtyAtLeast(qty.data(), count, min_qty, mask.data());
+        const auto expected_selected = selectQtyAtLeastScalar(qty.data(), count, min_qty, expected_mask.data());
+
+        EXPECT_EQ(selected, expected_selected) << qtyFilterImplementation() << ", count " << count;
+        EXPECT_EQ(mask, expected_mask) << qtyFilterImplementation() << ", count " << count;
+    }
+}
@@ -0,0 +1,243 @@
+#include "QtyLadder.h"
+#include "Bits.h"
+#include "Snapshot.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace
+{
+    constexpr std::uint32_t sub_buckets = 8;
+}
+
+std::uint32_t QtyLadder::bucketOf(unsigned int qty) noexcept
+{
+    if(qty < sub_buckets)
+    {
+        return qty;
+    }
+
+    // The power of two of the qty picks the bucket group, the next 3 bits the bucket in it.
+    const auto exponent = static_cast<std::uint32_t>(highestSetBit(qty));
+    const std::uint32_t sub_bucket = (qty >> (exponent - 3)) & (sub_buckets - 1);
+
+    return (exponent - 2) * sub_buckets + sub_bucket;
+}
+
+QtyLadder::Handle QtyLadder::add(OrderSlot slot, unsigned int qty)
+{
+    const std::uint32_t bucket = bucketOf(qty);
+
+    const auto it_bucket = std::lower_bound(buckets.begin(), buckets.end(), bucket);
+    const auto rank = it_bucket - buckets.begin();
+
+    if(it_bucket == buckets.end() || *it_bucket != bucket)
+    {
+        qty_order.insert(qty_order.begin() + rank, static_cast<RungIndex>(levels.size()));
+        buckets.insert(it_bucket, bucket);
+
+        levels.emplace_back().bucket = bucket;
+    }
+
+    const RungIndex rung_index = qty_order[rank];
+    Rung& rung = levels[rung_index];
+
+    rung.slots.push_back(slot);
+    rung.qtys.push_back(qty);
+    rung.total_qty += qty;
+
+    ++count;
+
+    return { rung_index, static_cast<std::uint32_t>(rung.size() - 1) };
+}
+
+OrderSlot QtyLadder::remove(Handle handle) noexcept
+{
+    Rung& rung = levels[handle.rung];
+
+    rung.total_qty -= rung.qtys[handle.position];
+    --count;
+
+    const OrderSlot moved = rung.slots.back();
+
+    rung.slots[handle.position] = moved;
+    rung.qtys[handle.position] = rung.qtys.back();
+    rung.slots.pop_back();
+    rung.qtys.pop_back();
+
+    return handle.position < rung.size() ? moved : none;
+}
+
+bool QtyLadder::setQty(Handle handle, unsigned int qty) noexcept
+{
+    Rung& rung = levels[handle.rung];
+
+    if(bucketOf(qty) != rung.bucket)
+    {
+        return false;
+    }
+
+    unsigned int& entry_qty = rung.qtys[handle.position];
+
+    rung.total_qty = rung.total_qty - entry_qty + qty;
+    entry_qty = qty;
+
+    return true;
+}
+
+bool QtyLadder::holds(Handle handle, OrderSlot slot, unsigned int qty) const noexcept
+{
+    if(handle.rung >= levels.size() || handle.position >= levels[handle.rung].size())
+    {
+        return false;
+    }
+
+    const Rung& rung = levels[handle.rung];
+
+    return rung.slots[handle.position] == slot && rung.qtys[handle.position] == qty;
+}
+
+std::size_t QtyLadder::memoryBytes() const noexcept
+{
+    std::size_t bytes = levels.capacity() * sizeof(Rung) + buckets.capacity() * sizeof(std::uint32_t) + qty_order.capacity() * sizeof(RungIndex);
+
+    for(const Rung& rung : levels)
+    {
+        bytes += rung.slots.capacity() * sizeof(OrderSlot) + rung.qtys.capacity() * sizeof(unsigned int);
+    }
+
+    return bytes;
+}
+
+std::size_t QtyLadder::shrinkRungs()
+{
+    const std::size_t bytes = memoryBytes();
+
+    levels.shrink_to_fit();
+    buckets.shrink_to_fit();
+    qty_order.shrink_to_fit();
+
+    return bytes - memoryBytes();
+}
+
+void QtyLadder::clear() noexcept
+{
+    levels.clear();
+    buckets.clear();
+    qty_order.clear();
+
+    count = 0;
+}
+
+std::size_t QtyLadder::firstRungFrom(unsigned int min_qty) const noexcept
+{
+    return static_cast<std::size_t>(std::lower_bound(buckets.begin(), buckets.end(), bucketOf(min_qty)) - buckets.begin());
+}
+
+unsigned long long QtyLadder::qtyAtLeast(unsigned int min_qty) const noexcept
+{
+    const std::size_t first = firstRungFrom(min_qty);
+
+    unsigned long long total = 0;
+
+    for(std::size_t rank = first; rank < buckets.size(); ++rank)
+    {
+        const Rung& rung = rungByQty(rank);
+
+        if(rank != first || rung.bucket != bucketOf(min_qty))
+        {
+            total += rung.total_qty;
+            continue;
+        }
+
+        for(const unsigned int qty : rung.qtys)
+        {
+            total += qty >= min_qty ? qty : 0;
+        }
+    }
+
+    return total;
+}
+
+void QtyLadder::save(SnapshotWriter& writer) const
+{
+    writer.value(static_cast<std::uint64_t>(levels.size()));
+
+    for(const Rung& rung : levels)
+    {
+        writer.value(rung.bucket);
+        writer.array(rung.slots);
+        writer.array(rung.qtys);
+    }
+}
+
+void QtyLadder::load(SnapshotReader& reader)
+{
+    clear();
+
+    const auto rung_count = reader.value<std::uint64_t>();
+
+    if(rung_count > bucketOf(~0u) + 1)
+    {
+        throw std::runtime_error{ "snapshot has a bad security index" };
+    }
+
+    levels.resize(static_cast<std::size_t>(rung_count));
+
+    for(Rung& rung : levels)
+    {
+        rung.bucket = reader.value<std::uint32_t>();
+        reader.array(rung.slots);
+        reader.array(rung.qtys);
+
+        if(rung.qtys.size() != rung.slots.size())
+        {
+            throw std::runtime_error{ "snapshot has a bad security index" };
+        }
+
+        for(const unsigned int qty : rung.qtys)
+        {
+            if(bucketOf(qty) != rung.bucket)
+            {
+                throw std::runtime_error{ "snapshot has a bad security index" };
+            }
+
+            rung.total_qty += qty;
+        }
+
+        count += rung.size();
+    }
+
+    if(!sortRungs())
+    {
+        throw std::runtime_error{ "snapshot has a bad security index" };
+    }
+}
+
+bool QtyLadder::sortRungs()
+{
+    std::vector<RungIndex>{}.swap(qty_order);
+    std::vector<std::uint32_t>{}.swap(buckets);
+
+    qty_order.reserve(levels.size());
+    buckets.reserve(levels.size());
+
+    for(RungIndex rung_index = 0; rung_index < levels.size(); ++rung_index)
+    {
+        qty_order.push_back(rung_index);
+    }
+
+    std::sort(qty_order.begin(), qty_order.end(), [this](RungIndex a, RungIndex b) { return levels[a].bucket < levels[b].bucket; });
+
+    for(const RungIndex rung_index : qty_order)
+    {
+        if(!buckets.empty() && buckets.back() == levels[rung_index].bucket)
+        {
+            return false;
+        }
+
+        buckets.push_back(levels[rung_index].bucket);
+    }
+
+    return true;
+}
@@ -0,0 +1,210 @@
+#pragma once
+
+#include "OrderStore.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class SnapshotReader;
+class SnapshotWriter;
+
+// The orders of one security and side, kept in rungs by qty.
+// A rung holds the orders whose qty falls into one log-linear bucket: qty below 8 get a bucket
+// each, and every power of two above is split in 8 buckets. The orders within a rung are in no
+// order; their qtys are kept contiguous so that the rung of a minimum qty can be filtered with SIMD. An order is found by its handle, the index of its rung and its position in it; the
+// position changes only when the order is moved into the place of a removed one, the index only
+// when compaction moves its rung into the place of a dropped one.
+class QtyLadder
+{
+public:
+    static constexpr OrderSlot none = SymbolTable::none;
+
+    // Rungs keep their index until compactRung drops another one; there are at most 240 of them.
+    using RungIndex = std::uint16_t;
+
+    struct Handle
+    {
+        RungIndex rung = 0;
+        std::uint32_t position = 0;
+    };
+
+    // The slots and qtys of the orders are at the same positions.
+    struct Rung
+    {
+        std::uint32_t bucket = 0;
+
+        std::vector<OrderSlot> slots;
+        std::vector<unsigned int> qtys;
+
+        unsigned long long total_qty = 0;
+
+        std::size_t size() const noexcept { return slots.size(); }
+    };
+
+    // return the bucket of a qty
+    static std::uint32_t bucketOf(unsigned int qty) noexcept;
+
+    // add the order and return its handle
+    Handle add(OrderSlot slot, unsigned int qty);
+
+    // remove the order with this handle
+    // The last order of the rung moves into its position; return the slot of the moved order,
+    // or none if the removed order was the last one.
+    OrderSlot remove(Handle handle) noexcept;
+
+    // set the qty of the order with this handle and return true, if the qty falls into the
+    // bucket of its rung; otherwise return false and leave the order as it is, to be removed
+    // and added again
+    bool setQty(Handle handle, unsigned int qty) noexcept;
+
+    // point the entry with this handle at another slot, for an order moved in the store
+    void setSlot(Handle handle, OrderSlot slot) noexcept { levels[handle.rung].slots[handle.position] = slot; }
+
+    // give back the room of the rung with this index beyond its orders, or drop the rung if it is
+    // empty, moving the last rung into its index
+    // Call renumber(OrderSlot, RungIndex) for every order of the moved rung. Return the number of
+    // orders looked at and add the number of bytes given back to released.
+    template <typename Renumber>
+    std::size_t compactRung(RungIndex rung, Renumber renumber, std::size_t& released);
+
+    // give back the room of the rung list beyond its rungs and return the number of bytes given back
+    std::size_t shrinkRungs();
+
+    // return true if the entry with this handle is the order in the slot with this qty
+    bool holds(Handle handle, OrderSlot slot, unsigned int qty) const noexcept;
+
+    // return the number of bytes held for the rungs and their orders
+    std::size_t memoryBytes() const noexcept;
+
+    // remove every order and rung
+    void clear() noexcept;
+
+    // return the number of orders
+    std::size_t size() const noexcept { return count; }
+
+    bool empty() const noexcept { return 0 == count; }
+
+    // return the number of rungs
+    // Rungs left empty by removals are kept until compactRung drops them, so removing orders
+    // never moves a rung.
+    std::size_t rungCount() const noexcept { return levels.size(); }
+
+    // return the rung at this rank in increasing qty order
+    const Rung& rungByQty(std::size_t rank) const noexcept { return levels[qty_order[rank]]; }
+
+    // return the rank of the first rung which may hold orders with qty >= min_qty
+    // Every rung after it holds only such orders. The orders of this rung with qty < min_qty have
+    // qty within an eighth below min_qty, and there are none for min_qty below 16.
+    std::size_t firstRungFrom(unsigned int min_qty) const noexcept;
+
+    // return the total qty of the orders with qty >= min_qty
+    unsigned long long qtyAtLeast(unsigned int min_qty) const noexcept;
+
+    // call visit(OrderSlot) for every order with qty in [min_qty, max_qty], until it returns false
+    // Return false if the walk was stopped.
+    template <typename Visit>
+    bool forEachInRange(unsigned int min_qty, unsigned int max_qty, Visit visit) const;
+
+    void save(SnapshotWriter& writer) const;
+    void load(SnapshotReader& reader);
+
+private:
+    // Bytes of an order in a rung, both columns.
+    static constexpr std::size_t order_bytes = sizeof(OrderSlot) + sizeof(unsigned int);
+
+    // In order of creation.
+    std::vector<Rung> levels;
+
+    // The buckets of the rungs in increasing order, and the index of the rung of each.
+    // Kept apart from the rungs so that finding one reads a few cache lines only.
+    std::vector<std::uint32_t> buckets;
+    std::vector<RungIndex> qty_order;
+
+    std::size_t count = 0;
+
+private:
+    // Rebuild buckets and qty_order from the rungs; return false if two rungs share a bucket.
+    bool sortRungs();
+};
+
+template <typename Renumber>
+std::size_t QtyLadder::compactRung(RungIndex rung, Renumber renumber, std::size_t& released)
+{
+    Rung& compacted = levels[rung];
+
+    if(0 != compacted.size())
+    {
+        if(compacted.slots.capacity() <= 2 * compacted.size())
+        {
+            return 0;
+        }
+
+        const std::size_t capacity = compacted.slots.capacity();
+
+        compacted.slots.shrink_to_fit();
+        compacted.qtys.shrink_to_fit();
+        released += (capacity - compacted.slots.capacity()) * order_bytes;
+
+        return compacted.size();
+    }
+
+    released += compacted.slots.capacity() * order_bytes;
+
+    const auto last = static_cast<RungIndex>(levels.size() - 1);
+
+    // Take the rung out of the qty order, then point the entry of the last rung at its new index.
+    const auto it_rank = std::find(qty_order.begin(), qty_order.end(), rung);
+
+    buckets.erase(buckets.begin() + (it_rank - qty_order.begin()));
+    qty_order.erase(it_rank);
+
+    std::size_t scanned = 0;
+
+    if(rung != last)
+    {
+        *std::find(qty_order.begin(), qty_order.end(), last) = rung;
+
+        levels[rung] = std::move(levels[last]);
+
+        for(const OrderSlot slot : levels[rung].slots)
+        {
+            renumber(slot, rung);
+        }
+
+        scanned = levels[rung].size();
+    }
+
+    levels.pop_back();
+
+    return scanned;
+}
+
+template <typename Visit>
+bool QtyLadder::forEachInRange(unsigned int min_qty, unsigned int max_qty, Visit visit) const
+{
+    const std::uint32_t first_bucket = bucketOf(min_qty);
+    const std::uint32_t last_bucket = bucketOf(max_qty);
+
+    for(std::size_t rank = firstRungFrom(min_qty); rank < buckets.size() && buckets[rank] <= last_bucket; ++rank)
+    {
+        const Rung& rung = rungByQty(rank);
+
+        // Only the rungs at either end of the range may hold orders outside of it.
+        const bool inside = rung.bucket != first_bucket && rung.bucket != last_bucket;
+
+        for(std::size_t position = 0; position < rung.size(); ++position)
+        {
+            if(inside || (rung.qtys[position] >= min_qty && rung.qtys[position] <= max_qty))
+            {
+                if(!visit(rung.slots[position]))
+                {
+                    return false;
+                }
+            }
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,116 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include "QtyLadder.h"
+
+TEST(QtyLadderTest, BucketsQtyInIncreasingOrder)
+{
+    for(unsigned int qty = 0; qty < 8; ++qty)
+    {
+        EXPECT_EQ(QtyLadder::bucketOf(qty), qty);
+    }
+
+    std::uint32_t previous = QtyLadder::bucketOf(0);
+
+    for(unsigned int qty = 1; qty < 100000; ++qty)
+    {
+        const std::uint32_t bucket = QtyLadder::bucketOf(qty);
+
+        EXPECT_TRUE(bucket == previous || bucket == previous + 1) << qty;
+        previous = bucket;
+    }
+
+    // A bucket spans at most 1/8 of its qty.
+    EXPECT_EQ(QtyLadder::bucketOf(1536), QtyLadder::bucketOf(1663));
+    EXPECT_NE(QtyLadder::bucketOf(1663), QtyLadder::bucketOf(1664));
+    EXPECT_EQ(QtyLadder::bucketOf(std::numeric_limits<unsigned int>::max()), 29u * 8 + 7);
+}
+
+TEST(QtyLadderTest, KeepsPositionsAndTotalsThroughRemovals)
+{
+    QtyLadder ladder;
+
+    std::mt19937 rng{ 3 };
+
+    std::vector<unsigned int> qty(2000);
+    std::vector<QtyLadder::Handle> handle(qty.size());
+
+    for(OrderSlot slot = 0; slot < qty.size(); ++slot)
+    {
+        qty[slot] = 1 + rng() % 5000;
+        handle[slot] = ladder.add(slot, qty[slot]);
+    }
+
+    // Remove every third order, following the moves of the last order of each rung.
+    std::vector<bool> live(qty.size(), true);
+
+    for(OrderSlot slot = 0; slot < qty.size(); slot += 3)
+    {
+        if(const OrderSlot moved = ladder.remove(handle[slot]); QtyLadder::none != moved)
+        {
+            handle[moved].position = handle[slot].position;
+        }
+
+        live[slot] = false;
+    }
+
+    std::size_t count = 0;
+
+    for(std::size_t rank = 0; rank < ladder.rungCount(); ++rank)
+    {
+        const QtyLadder::Rung& rung = ladder.rungByQty(rank);
+
+        if(0 != rank)
+        {
+            EXPECT_LT(ladder.rungByQty(rank - 1).bucket, rung.bucket);
+        }
+
+        ASSERT_EQ(rung.qtys.size(), rung.size());
+
+        for(std::size_t p = 0; p < rung.size(); ++p)
+        {
+            const OrderSlot slot = rung.slots[p];
+
+            EXPECT_TRUE(live[slot]);
+            EXPECT_EQ(handle[slot].position, p);
+            EXPECT_EQ(rung.qtys[p], qty[slot]);
+            EXPECT_EQ(QtyLadder::bucketOf(rung.qtys[p]), rung.bucket);
+        }
+
+        count += rung.size();
+    }
+
+    EXPECT_EQ(count, ladder.size());
+
+    for(const unsigned int min_qty : { 0u, 1u, 700u, 2048u, 4999u, 6000u })
+    {
+        unsigned long long expected = 0;
+
+        for(OrderSlot slot = 0; slot < qty.size(); ++slot)
+        {
+            expected += live[slot] && qty[slot] >= min_qty ? qty[slot] : 0;
+        }
+
+        EXPECT_EQ(ladder.qtyAtLeast(min_qty), expected) << min_qty;
+    }
+
+    std::vector<OrderSlot> in_range;
+    ladder.forEachInRange(1000, 1100, [&](OrderSlot slot) { in_range.push_back(slot); return true; });
+    std::sort(in_range.begin(), in_range.end());
+
+    std::vector<OrderSlot> expected;
+
+    for(OrderSlot slot = 0; slot < qty.size(); ++slot)
+    {
+        if(live[slot] && qty[slot] >= 1000 && qty[slot] <= 1100)
+        {
+            expected.push_back(slot);
+        }
+    }
+
+    EXPECT_EQ(in_range, expected);
+}
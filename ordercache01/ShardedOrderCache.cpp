@@ -0,0 +1,281 @@
+#include "ShardedOrderCache.h"
+
+#include <functional>
+#include <utility>
+
+/*
+   Locks are always taken in the order: directory shard, then cache shard.
+   Bulk cancels by user or company and getAllOrders take every cache shard at once, in increasing
+   index order, and no directory shard while they hold them.
+*/
+
+ShardedOrderCache::ShardedOrderCache(std::size_t shard_count, MatchingReads matching_reads) :
+    shards(shard_count ? shard_count : 1),
+    directory(shard_count ? shard_count : 1),
+    matching_reads{ matching_reads }
+{
+}
+
+void ShardedOrderCache::addOrder(Order order)
+{
+    // The shard cache would reject the order too, but after its id went into the directory.
+    if(!parseSide(order.side()))
+    {
+        return;
+    }
+
+    const std::string order_id = order.orderId();
+
+    DirectoryShard& directory_shard = directoryOfOrder(order_id);
+    std::lock_guard directory_lock{ directory_shard.mutex };
+
+    // The order id may still be in another shard, if so the order is a duplicate.
+    if(const auto it_entry = directory_shard.shard_of_order.find(order_id); it_entry != directory_shard.shard_of_order.end())
+    {
+        Shard& shard = shards[it_entry->second];
+        std::lock_guard lock{ shard.mutex };
+
+        if(shard.cache.containsOrder(order_id))
+        {
+            return;
+        }
+    }
+
+    const std::size_t shard_index = shardOfSecurity(order.securityId());
+
+    {
+        Shard& shard = shards[shard_index];
+        std::lock_guard lock{ shard.mutex };
+
+        shard.cache.addOrder(std::move(order));
+        publishChanges(shard);
+    }
+
+    directory_shard.shard_of_order[order_id] = shard_index;
+}
+
+void ShardedOrderCache::cancelOrder(const std::string& orderId)
+{
+    DirectoryShard& directory_shard = directoryOfOrder(orderId);
+    std::lock_guard directory_lock{ directory_shard.mutex };
+
+    const auto it_entry = directory_shard.shard_of_order.find(orderId);
+
+    if(it_entry == directory_shard.shard_of_order.end())
+    {
+        return;
+    }
+
+    {
+        Shard& shard = shards[it_entry->second];
+        std::lock_guard lock{ shard.mutex };
+
+        shard.cache.cancelOrder(orderId);
+        publishChanges(shard);
+    }
+
+    directory_shard.shard_of_order.erase(it_entry);
+}
+
+template <typename Change>
+void ShardedOrderCache::changeOrder(const std::string& orderId, Change change)
+{
+    DirectoryShard& directory_shard = directoryOfOrder(orderId);
+    std::lock_guard directory_lock{ directory_shard.mutex };
+
+    const auto it_entry = directory_shard.shard_of_order.find(orderId);
+
+    if(it_entry == directory_shard.shard_of_order.end())
+    {
+        return;
+    }
+
+    bool removed = false;
+
+    {
+        Shard& shard = shards[it_entry->second];
+        std::lock_guard lock{ shard.mutex };
+
+        change(shard.cache);
+        publishChanges(shard);
+
+        removed = !shard.cache.containsOrder(orderId);
+    }
+
+    if(removed)
+    {
+        directory_shard.shard_of_order.erase(it_entry);
+    }
+}
+
+void ShardedOrderCache::amendQty(const std::string& orderId, unsigned int qty)
+{
+    changeOrder(orderId, [&](OrderCache& cache) { cache.amendQty(orderId, qty); });
+}
+
+void ShardedOrderCache::reduceQty(const std::string& orderId, unsigned int delta)
+{
+    changeOrder(orderId, [&](OrderCache& cache) { cache.reduceQty(orderId, delta); });
+}
+
+void ShardedOrderCache::cancelOrdersForUser(const std::string& user)
+{
+    cancelOnAllShards([&](OrderCache& cache, std::vector<std::string>& cancelled) { cache.cancelOrdersForUser(user, cancelled); });
+}
+
+void ShardedOrderCache::cancelOrdersForCompany(const std::string& company)
+{
+    cancelOnAllShards([&](OrderCache& cache, std::vector<std::string>& cancelled) { cache.cancelOrdersForCompany(company, cancelled); });
+}
+
+template <typename Cancel>
+void ShardedOrderCache::cancelOnAllShards(Cancel cancel)
+{
+    std::vector<std::vector<std::string>> cancelled(shards.size());
+
+    {
+        // Hold all shards at once so that no add or cancel lands between the shards of the cancel.
+        const auto locks = lockAllShards();
+
+        for(std::size_t shard_index = 0; shard_index < shards.size(); ++shard_index)
+        {
+            Shard& shard = shards[shard_index];
+
+            cancel(shard.cache, cancelled[shard_index]);
+            publishChanges(shard);
+        }
+    }
+
+    for(std::size_t shard_index = 0; shard_index < shards.size(); ++shard_index)
+    {
+        forgetCancelledOrders(shard_index, cancelled[shard_index]);
+    }
+}
+
+OrderCache::OpenQty ShardedOrderCache::getOpenQtyForCompany(const std::string& company, const std::string& securityId) const
+{
+    const Shard& shard = shards[shardOfSecurity(securityId)];
+    std::lock_guard lock{ shard.mutex };
+
+    return shard.cache.getOpenQtyForCompany(company, securityId);
+}
+
+void ShardedOrderCache::cancelOrdersForSecIdWithMinimumQty(const std::string& securityId, unsigned int minQty)
+{
+    const std::size_t shard_index = shardOfSecurity(securityId);
+
+    std::vector<std::string> cancelled;
+
+    {
+        Shard& shard = shards[shard_index];
+        std::lock_guard lock{ shard.mutex };
+
+        shard.cache.cancelOrdersForSecIdWithMinimumQty(securityId, minQty, cancelled);
+        publishChanges(shard);
+    }
+
+    forgetCancelledOrders(shard_index, cancelled);
+}
+
+unsigned int ShardedOrderCache::getMatchingSizeForSecurity(const std::string& securityId)
+{
+    Shard& shard = shards[shardOfSecurity(securityId)];
+    std::lock_guard lock{ shard.mutex };
+
+    return shard.cache.getMatchingSizeForSecurity(securityId);
+}
+
+unsigned int ShardedOrderCache::readMatchingSizeForSecurity(const std::string& securityId) const
+{
+    if(MatchingReads::Published == matching_reads)
+    {
+        return matching_sizes.read(securityId);
+    }
+
+    const Shard& shard = shards[shardOfSecurity(securityId)];
+    std::lock_guard lock{ shard.mutex };
+
+    return shard.cache.getMatchingSizeForSecurity(securityId);
+}
+
+std::vector<Order> ShardedOrderCache::getAllOrders() const
+{
+    // Hold all shards at once so the result is a single point in time.
+    const auto locks = lockAllShards();
+
+    std::vector<Order> orders;
+
+    for(const Shard& shard : shards)
+    {
+        auto shard_orders = shard.cache.getAllOrders();
+
+        orders.insert(orders.end(), std::make_move_iterator(shard_orders.begin()), std::make_move_iterator(shard_orders.end()));
+    }
+
+    return orders;
+}
+
+std::vector<std::unique_lock<std::mutex>> ShardedOrderCache::lockAllShards() const
+{
+    std::vector<std::unique_lock<std::mutex>> locks;
+    locks.reserve(shards.size());
+
+    for(const Shard& shard : shards)
+    {
+        locks.emplace_back(shard.mutex);
+    }
+
+    return locks;
+}
+
+std::size_t ShardedOrderCache::shardOfSecurity(const std::string& securityId) const
+{
+    return std::hash<std::string>{}(securityId) % shards.size();
+}
+
+ShardedOrderCache::DirectoryShard& ShardedOrderCache::directoryOfOrder(const std::string& orderId)
+{
+    return directory[std::hash<std::string>{}(orderId) % directory.size()];
+}
+
+void ShardedOrderCache::publishChanges(Shard& shard)
+{
+    if(MatchingReads::Published != matching_reads)
+    {
+        return;
+    }
+
+    shard.changed.clear();
+    shard.changed_sizes.clear();
+    shard.cache.takeChangedSecurities(shard.changed, shard.changed_sizes);
+
+    for(std::size_t i = 0; i < shard.changed.size(); ++i)
+    {
+        matching_sizes.publish(shard.changed[i], shard.changed_sizes[i]);
+    }
+}
+
+void ShardedOrderCache::forgetCancelledOrders(std::size_t shard_index, const std::vector<std::string>& cancelled)
+{
+    for(const std::string& order_id : cancelled)
+    {
+        DirectoryShard& directory_shard = directoryOfOrder(order_id);
+        std::lock_guard directory_lock{ directory_shard.mutex };
+
+        const auto it_entry = directory_shard.shard_of_order.find(order_id);
+
+        // The order id may have been added again since, to this or another shard.
+        if(it_entry == directory_shard.shard_of_order.end() || it_entry->second != shard_index)
+        {
+            continue;
+        }
+
+        Shard& shard = shards[shard_index];
+        std::lock_guard lock{ shard.mutex };
+
+        if(!shard.cache.containsOrder(order_id))
+        {
+            directory_shard.shard_of_order.erase(it_entry);
+        }
+    }
+}
@@ -0,0 +1,157 @@
+#pragma once
+
+#include "MatchingSizeBoard.h"
+#include "OrderCache.h"
+
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+// An OrderCacheInterface safe to use from many threads at once.
+// Orders are partitioned by security id across shards, each an OrderCache with its own lock.
+// A directory, sharded by order id, remembers which shard holds each order id, so that
+// per-order calls lock a single shard.
+class ShardedOrderCache : public OrderCacheInterface
+{
+public:
+    // How readMatchingSizeForSecurity gets its result.
+    enum class MatchingReads
+    {
+        // Lock the shard of the security and compute the matching size.
+        Locked,
+
+        // Read the matching size published by the last writer, without any lock.
+        // Every mutation publishes the matching size of the securities it changed.
+        Published,
+    };
+
+    explicit ShardedOrderCache(std::size_t shard_count = 16, MatchingReads matching_reads = MatchingReads::Locked);
+
+    // add order to the cache
+    void addOrder(Order order) override;
+
+    // remove order with this unique order id from the cache
+    void cancelOrder(const std::string& orderId) override;
+
+    // remove all orders in the cache for this user
+    // Locks every shard at once, so the cancel takes effect at a single point in time.
+    void cancelOrdersForUser(const std::string& user) override;
+
+    // remove all orders in the cache for this security with qty >= minQty
+    void cancelOrdersForSecIdWithMinimumQty(const std::string& securityId, unsigned int minQty) override;
+
+    // return the total qty that can match for the security id
+    unsigned int getMatchingSizeForSecurity(const std::string& securityId) override;
+
+    // return all orders in cache in a vector
+    std::vector<Order> getAllOrders() const override;
+
+    // call visit(const OrderView&) for every order in the cache, without copying them
+    // All shards stay locked during the walk, so visit must not call back into the cache.
+    // visit may return bool, false stops the walk.
+    template <typename Visit>
+    void forEachOrder(Visit visit) const;
+
+    // remove all orders in the cache for this company
+    // Locks every shard at once, so the cancel takes effect at a single point in time.
+    void cancelOrdersForCompany(const std::string& company);
+
+    // set the qty of the order with this order id, removing the order if qty is 0
+    void amendQty(const std::string& orderId, unsigned int qty);
+
+    // reduce the qty of the order with this order id by delta, removing the order once no qty is left
+    void reduceQty(const std::string& orderId, unsigned int delta);
+
+    // return the open qty of the company in the security
+    OrderCache::OpenQty getOpenQtyForCompany(const std::string& company, const std::string& securityId) const;
+
+    // return the total qty that can match for the security id
+    // Wait-free when the cache was created with MatchingReads::Published.
+    unsigned int readMatchingSizeForSecurity(const std::string& securityId) const;
+
+    // return the number of shards
+    std::size_t shardCount() const noexcept { return shards.size(); }
+
+private:
+    // Aligned to keep the locks of neighbouring shards off the same cache line.
+    struct alignas(64) Shard
+    {
+        mutable std::mutex mutex;
+        mutable OrderCache cache;
+
+        // Scratch lists of securities changed by the last mutation and their matching sizes.
+        std::vector<std::string> changed;
+        std::vector<unsigned int> changed_sizes;
+    };
+
+    // Order id to the index of the shard holding the order.
+    // An entry may outlive its order after a bulk cancel until it is cleaned up; the shard
+    // is the source of truth and is always checked under the lock.
+    struct alignas(64) DirectoryShard
+    {
+        std::mutex mutex;
+        std::unordered_map<std::string, std::size_t> shard_of_order;
+    };
+
+private:
+    std::vector<Shard> shards;
+    std::vector<DirectoryShard> directory;
+
+    const MatchingReads matching_reads;
+    MatchingSizeBoard matching_sizes;
+
+private:
+    // Lock every shard, in increasing index order.
+    std::vector<std::unique_lock<std::mutex>> lockAllShards() const;
+
+    std::size_t shardOfSecurity(const std::string& securityId) const;
+    DirectoryShard& directoryOfOrder(const std::string& orderId);
+
+    // Publish the matching sizes of the securities just changed on the shard. Called with the shard locked.
+    void publishChanges(Shard& shard);
+
+    // Call change(OrderCache&) on the shard holding the order, which may remove the order.
+    template <typename Change>
+    void changeOrder(const std::string& orderId, Change change);
+
+    // Call cancel(OrderCache&, std::vector<std::string>& cancelled) on every shard, with all shards
+    // locked, then forget the cancelled orders in the directory.
+    template <typename Cancel>
+    void cancelOnAllShards(Cancel cancel);
+
+    // Remove directory entries of orders cancelled by a bulk cancel on the shard.
+    void forgetCancelledOrders(std::size_t shard_index, const std::vector<std::string>& cancelled);
+};
+
+template <typename Visit>
+void ShardedOrderCache::forEachOrder(Visit visit) const
+{
+    const auto locks = lockAllShards();
+
+    bool stopped = false;
+
+    for(const Shard& shard : shards)
+    {
+        shard.cache.forEachOrder([&visit, &stopped](const OrderView& order)
+        {
+            if constexpr(std::is_void_v<std::invoke_result_t<Visit&, const OrderView&>>)
+            {
+                visit(order);
+            }
+            else
+            {
+                stopped = !visit(order);
+            }
+
+            return !stopped;
+        });
+
+        if(stopped)
+        {
+            return;
+        }
+    }
+}
@@ -0,0 +1,326 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "OrderCacheTestHelpers.h"
+#include "ShardedOrderCache.h"
+
+TEST(ShardedOrderCacheTest, BehavesLikeOrderCacheSingleThreaded)
+{
+    ShardedOrderCache sharded{ 4 };
+    OrderCache cache;
+
+    for(const auto& op : makeOperations(0, 5000))
+    {
+        apply(sharded, op);
+        apply(cache, op);
+    }
+
+    EXPECT_EQ(sortedFields(sharded.getAllOrders()), sortedFields(cache.getAllOrders()));
+
+    for(int s = 0; s < 40; ++s)
+    {
+        const std::string security = "s" + std::to_string(s);
+        EXPECT_EQ(sharded.getMatchingSizeForSecurity(security), cache.getMatchingSizeForSecurity(security)) << security;
+    }
+}
+
+TEST(ShardedOrderCacheTest, VisitsOrdersOfEveryShard)
+{
+    ShardedOrderCache cache{ 4 };
+
+    for(int i = 0; i < 200; ++i)
+    {
+        cache.addOrder({ "o" + std::to_string(i), "s" + std::to_string(i % 17), i % 2 ? "Buy" : "Sell", 100, "u1", "c1" });
+    }
+
+    std::vector<Order> visited;
+    cache.forEachOrder([&](const OrderView& order) { visited.push_back(order.toOrder()); });
+
+    EXPECT_EQ(sortedFields(visited), sortedFields(cache.getAllOrders()));
+
+    int count = 0;
+    cache.forEachOrder([&](const OrderView&) { return ++count < 5; });
+
+    EXPECT_EQ(count, 5);
+}
+
+TEST(ShardedOrderCacheTest, CancelsCompanyOrdersOfEveryShard)
+{
+    ShardedOrderCache cache{ 4 };
+
+    for(int i = 0; i < 200; ++i)
+    {
+        cache.addOrder({ "o" + std::to_string(i), "s" + std::to_string(i % 17), i % 2 ? "Buy" : "Sell", 100, "u1", "c" + std::to_string(i % 3) });
+    }
+
+    EXPECT_EQ(cache.getOpenQtyForCompany("c1", "s1").total(), 400u);
+
+    cache.cancelOrdersForCompany("c1");
+
+    EXPECT_EQ(cache.getOpenQtyForCompany("c1", "s1").total(), 0u);
+
+    for(const Order& order : cache.getAllOrders())
+    {
+        EXPECT_NE(order.company(), "c1");
+    }
+
+    // The ids of the cancelled orders can be used again.
+    cache.addOrder({ "o1", "s1", "Buy", 100, "u1", "c1" });
+
+    EXPECT_EQ(cache.getOpenQtyForCompany("c1", "s1").buy, 100u);
+}
+
+TEST(ShardedOrderCacheTest, HandlesOrderMovedToAnotherShard)
+{
+    ShardedOrderCache cache{ 8 };
+
+    // Cancel by user leaves the order id in the directory until it is cleaned up;
+    // the same id must still be accepted for another security.
+    for(int i = 0; i < 64; ++i)
+    {
+        const std::string security = "s" + std::to_string(i);
+
+        cache.addOrder({ "o1", security, "Buy", 100, "u1", "c1" });
+        cache.addOrder({ "o1", "other", "Sell", 100, "u1", "c2" });
+        cache.cancelOrdersForUser("u1");
+    }
+
+    cache.addOrder({ "o1", "s1", "Buy", 100, "u1", "c1" });
+    cache.addOrder({ "o1", "s2", "Sell", 100, "u1", "c2" });
+
+    const auto orders = cache.getAllOrders();
+
+    ASSERT_EQ(orders.size(), 1u);
+    EXPECT_EQ(orders[0].securityId(), "s1");
+}
+
+TEST(ShardedOrderCacheTest, MatchesSingleThreadedReplayUnderConcurrentWriters)
+{
+    constexpr int writers = 8;
+    constexpr int operations = 20000;
+
+    std::vector<std::vector<Operation>> ops;
+
+    for(int w = 0; w < writers; ++w)
+    {
+        ops.push_back(makeOperations(w, operations));
+    }
+
+    ShardedOrderCache sharded{ 8 };
+
+    std::atomic<bool> done{ false };
+    std::atomic<bool> duplicate_seen{ false };
+
+    std::vector<std::thread> threads;
+
+    for(int w = 0; w < writers; ++w)
+    {
+        threads.emplace_back([&, w]
+        {
+            for(const auto& op : ops[w])
+            {
+                apply(sharded, op);
+            }
+        });
+    }
+
+    // Readers run alongside; every snapshot must hold each order id at most once.
+    for(int r = 0; r < 2; ++r)
+    {
+        threads.emplace_back([&]
+        {
+            while(!done)
+            {
+                sharded.getMatchingSizeForSecurity("s1");
+
+                auto fields = sortedFields(sharded.getAllOrders());
+
+                const auto same_id = [](const OrderFields& a, const OrderFields& b) { return std::get<0>(a) == std::get<0>(b); };
+
+                if(std::adjacent_find(std::begin(fields), std::end(fields), same_id) != std::end(fields))
+                {
+                    duplicate_seen = true;
+                }
+            }
+        });
+    }
+
+    for(int w = 0; w < writers; ++w)
+    {
+        threads[w].join();
+    }
+
+    done = true;
+
+    for(std::size_t t = writers; t < threads.size(); ++t)
+    {
+        threads[t].join();
+    }
+
+    OrderCache cache;
+
+    for(const auto& writer_ops : ops)
+    {
+        for(const auto& op : writer_ops)
+        {
+            apply(cache, op);
+        }
+    }
+
+    EXPECT_FALSE(duplicate_seen);
+    EXPECT_EQ(sortedFields(sharded.getAllOrders()), sortedFields(cache.getAllOrders()));
+
+    for(int s = 0; s < 40; ++s)
+    {
+        const std::string security = "s" + std::to_string(s);
+        EXPECT_EQ(sharded.getMatchingSizeForSecurity(security), cache.getMatchingSizeForSecurity(security)) << security;
+    }
+}
+
+TEST(ShardedOrderCacheTest, CancelsUserAndCompanyOrdersAtOnePointInTime)
+{
+    constexpr int orders = 20000;
+
+    ShardedOrderCache sharded{ 8 };
+
+    std::atomic<bool> done{ false };
+
+    // One thread adds the orders of the user one after another, to securities spread over the
+    // shards, while another cancels them in bulk. An order added before a bulk cancel must be gone
+    // after it, so the orders left are the ones added after the last cancel: a suffix of the adds.
+    std::thread adder{ [&]
+    {
+        for(int i = 0; i < orders; ++i)
+        {
+            sharded.addOrder({ "o" + std::to_string(i), "s" + std::to_string(i % 97), i % 2 ? "Buy" : "Sell", 100, "u1", "c1" });
+        }
+
+        done = true;
+    } };
+
+    std::thread canceller{ [&]
+    {
+        for(int i = 0; !done; ++i)
+        {
+            if(i % 2)
+            {
+                sharded.cancelOrdersForUser("u1");
+            }
+            else
+            {
+                sharded.cancelOrdersForCompany("c1");
+            }
+        }
+    } };
+
+    adder.join();
+    canceller.join();
+
+    std::vector<int> left;
+
+    for(const auto& order : sharded.getAllOrders())
+    {
+        left.push_back(std::stoi(order.orderId().substr(1)));
+    }
+
+    std::sort(std::begin(left), std::end(left));
+
+    for(std::size_t i = 0; i < left.size(); ++i)
+    {
+        ASSERT_EQ(left[i], orders - static_cast<int>(left.size() - i)) << "an order added before a bulk cancel outlived it";
+    }
+}
+
+TEST(ShardedOrderCacheTest, PublishesMatchingSizesForLockFreeReads)
+{
+    constexpr int writers = 4;
+
+    ShardedOrderCache sharded{ 8, ShardedOrderCache::MatchingReads::Published };
+
+    std::atomic<bool> done{ false };
+    std::vector<std::thread> threads;
+
+    for(int w = 0; w < writers; ++w)
+    {
+        threads.emplace_back([&, w]
+        {
+            for(const auto& op : makeOperations(w, 10000))
+            {
+                apply(sharded, op);
+            }
+        });
+    }
+
+    std::atomic<unsigned long long> reads{ 0 };
+
+    threads.emplace_back([&]
+    {
+        while(!done)
+        {
+            for(int s = 0; s < 40; ++s)
+            {
+                sharded.readMatchingSizeForSecurity("s" + std::to_string(s));
+                ++reads;
+            }
+        }
+    });
+
+    for(int w = 0; w < writers; ++w)
+    {
+        threads[w].join();
+    }
+
+    done = true;
+    threads.back().join();
+
+    EXPECT_GT(reads, 0u);
+
+    // Once the writers are done, every published value is the current one.
+    for(int s = 0; s < 40; ++s)
+    {
+        const std::string security = "s" + std::to_string(s);
+        EXPECT_EQ(sharded.readMatchingSizeForSecurity(security), sharded.getMatchingSizeForSecurity(security)) << security;
+    }
+
+    for(int w = 0; w < writers; ++w)
+    {
+        for(int p = 0; p < 4; ++p)
+        {
+            const std::string security = "p" + std::to_string(w) + "-" + std::to_string(p);
+            EXPECT_EQ(sharded.readMatchingSizeForSecurity(security), sharded.getMatchingSizeForSecurity(security)) << security;
+        }
+    }
+}
+
+TEST(ShardedOrderCacheTest, AmendsAndReducesQtyOfOrders)
+{
+    ShardedOrderCache cache{ 4 };
+
+    cache.addOrder({ "o1", "s1", "Buy", 300, "u1", "c1" });
+    cache.addOrder({ "o2", "s1", "Sell", 200, "u2", "c2" });
+
+    cache.reduceQty("o1", 150);
+    EXPECT_EQ(cache.getMatchingSizeForSecurity("s1"), 150u);
+
+    cache.amendQty("o2", 100);
+    EXPECT_EQ(cache.getMatchingSizeForSecurity("s1"), 100u);
+
+    // A complete fill removes the order, and its id can be used again for another security.
+    cache.reduceQty("o1", 150);
+    EXPECT_EQ(cache.getAllOrders().size(), 1u);
+
+    cache.addOrder({ "o1", "s2", "Buy", 100, "u1", "c1" });
+    cache.amendQty("o1", 0);
+    cache.amendQty("o3", 10);
+
+    const auto orders = cache.getAllOrders();
+
+    ASSERT_EQ(orders.size(), 1u);
+    EXPECT_EQ(orders[0].orderId(), "o2");
+    EXPECT_EQ(orders[0].qty(), 100u);
+}
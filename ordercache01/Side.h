@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+// Side of an order, parsed once from its name when the order is added.
+enum class Side : std::uint8_t
+{
+    Buy = 0,
+    Sell = 1,
+};
+
+constexpr std::size_t side_count = 2;
+
+// return the side named "Buy" or "Sell", or nothing for any other name
+inline std::optional<Side> parseSide(std::string_view name) noexcept
+{
+    if("Buy" == name)
+    {
+        return Side::Buy;
+    }
+
+    if("Sell" == name)
+    {
+        return Side::Sell;
+    }
+
+    return std::nullopt;
+}
+
+// return the name of the side, as Order has it
+inline const std::string& sideName(Side side)
+{
+    static const std::string names[side_count] = { "Buy", "Sell" };
+
+    return names[static_cast<std::size_t>(side)];
+}
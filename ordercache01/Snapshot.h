@@ -0,0 +1,282 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// A 64-bit checksum of a stream of bytes, fed in pieces of any size.
+// Four independent lanes take 8 bytes each per round, so it runs at several bytes per cycle.
+class SnapshotChecksum
+{
+public:
+    void update(const void* data, std::size_t size) noexcept
+    {
+        if(0 == size)
+        {
+            return;
+        }
+
+        const auto* bytes = static_cast<const unsigned char*>(data);
+
+        length += size;
+
+        if(0 != filled)
+        {
+            const std::size_t taken = size < block_size - filled ? size : block_size - filled;
+
+            std::memcpy(block + filled, bytes, taken);
+            filled += taken;
+            bytes += taken;
+            size -= taken;
+
+            if(filled < block_size)
+            {
+                return;
+            }
+
+            round(block);
+            filled = 0;
+        }
+
+        for(; size >= block_size; bytes += block_size, size -= block_size)
+        {
+            round(bytes);
+        }
+
+        std::memcpy(block, bytes, size);
+        filled = size;
+    }
+
+    // return the checksum of the bytes fed so far
+    std::uint64_t value() const noexcept
+    {
+        std::uint64_t hash = length * prime_1;
+
+        for(int lane = 0; lane < 4; ++lane)
+        {
+            hash = (hash ^ mix(0, lanes[lane])) * prime_1 + prime_2;
+        }
+
+        // The bytes of the last, partial block, with zeros after them.
+        unsigned char tail[block_size] = {};
+
+        std::memcpy(tail, block, filled);
+
+        for(std::size_t at = 0; at < block_size; at += 8)
+        {
+            hash = (hash ^ mix(0, word(tail + at))) * prime_1 + prime_2;
+        }
+
+        hash ^= hash >> 29;
+        hash *= prime_2;
+
+        return hash ^ (hash >> 32);
+    }
+
+private:
+    static constexpr std::size_t block_size = 32;
+
+    static constexpr std::uint64_t prime_1 = 0x9e3779b185ebca87ull;
+    static constexpr std::uint64_t prime_2 = 0xc2b2ae3d27d4eb4full;
+
+    std::uint64_t lanes[4] = { prime_1, prime_2, 0, ~prime_1 };
+
+    unsigned char block[block_size] = {};
+    std::size_t filled = 0;
+
+    std::uint64_t length = 0;
+
+private:
+    static std::uint64_t word(const unsigned char* bytes) noexcept
+    {
+        std::uint64_t w;
+        std::memcpy(&w, bytes, sizeof(w));
+
+        return w;
+    }
+
+    static std::uint64_t mix(std::uint64_t lane, std::uint64_t w) noexcept
+    {
+        lane += w * prime_2;
+        lane = (lane << 31) | (lane >> 33);
+
+        return lane * prime_1;
+    }
+
+    void round(const unsigned char* bytes) noexcept
+    {
+        for(int lane = 0; lane < 4; ++lane)
+        {
+            lanes[lane] = mix(lanes[lane], word(bytes + 8 * lane));
+        }
+    }
+};
+
+// Writes the binary snapshot format: plain values and arrays in native byte order.
+// Arrays are written as their element count followed by their bytes, so they load with one copy.
+// finish ends the file with the checksum of everything written before.
+class SnapshotWriter
+{
+public:
+    explicit SnapshotWriter(const std::string& path) :
+        file{ path, std::ios::binary | std::ios::trunc }
+    {
+        if(!file)
+        {
+            throw std::runtime_error{ "cannot create " + path };
+        }
+    }
+
+    template <typename T>
+    void value(const T& v)
+    {
+        static_assert(std::is_trivially_copyable_v<T>);
+
+        bytes(&v, sizeof(T));
+    }
+
+    template <typename T>
+    void array(const std::vector<T>& values)
+    {
+        static_assert(std::is_trivially_copyable_v<T>);
+
+        value(static_cast<std::uint64_t>(values.size()));
+        bytes(values.data(), values.size() * sizeof(T));
+    }
+
+    void string(const std::string& s)
+    {
+        value(static_cast<std::uint64_t>(s.size()));
+        bytes(s.data(), s.size());
+    }
+
+    // write the checksum and flush the file, throw std::runtime_error if anything failed to be written
+    void finish()
+    {
+        const std::uint64_t sum = checksum.value();
+
+        file.write(reinterpret_cast<const char*>(&sum), sizeof(sum));
+        file.flush();
+
+        if(!file)
+        {
+            throw std::runtime_error{ "cannot write snapshot" };
+        }
+    }
+
+private:
+    std::ofstream file;
+
+    SnapshotChecksum checksum;
+
+private:
+    void bytes(const void* data, std::size_t size)
+    {
+        checksum.update(data, size);
+        file.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+    }
+};
+
+// Reads what SnapshotWriter wrote from memory, usually a MappedFile.
+// Throws std::runtime_error when the data ends too early.
+class SnapshotReader
+{
+public:
+    SnapshotReader(const unsigned char* data, std::size_t size) :
+        begin{ data },
+        cursor{ data },
+        end{ data + size }
+    {
+    }
+
+    // check the checksum SnapshotWriter::finish wrote at the end and stop reading before it
+    // Throws std::runtime_error if it does not match the data.
+    void checkChecksum()
+    {
+        std::uint64_t sum = 0;
+
+        if(static_cast<std::size_t>(end - cursor) < sizeof(sum))
+        {
+            throw std::runtime_error{ "snapshot is truncated" };
+        }
+
+        end -= sizeof(sum);
+        std::memcpy(&sum, end, sizeof(sum));
+
+        SnapshotChecksum checksum;
+        checksum.update(begin, static_cast<std::size_t>(end - begin));
+
+        if(checksum.value() != sum)
+        {
+            throw std::runtime_error{ "snapshot has a bad checksum" };
+        }
+    }
+
+    template <typename T>
+    T value()
+    {
+        static_assert(std::is_trivially_copyable_v<T>);
+
+        T v;
+        std::memcpy(&v, take(sizeof(T)), sizeof(T));
+
+        return v;
+    }
+
+    template <typename T>
+    void array(std::vector<T>& values)
+    {
+        static_assert(std::is_trivially_copyable_v<T>);
+
+        const auto count = value<std::uint64_t>();
+
+        if(count > static_cast<std::uint64_t>(end - cursor) / sizeof(T))
+        {
+            throw std::runtime_error{ "snapshot is truncated" };
+        }
+
+        values.resize(static_cast<std::size_t>(count));
+
+        if(count)
+        {
+            std::memcpy(values.data(), take(values.size() * sizeof(T)), values.size() * sizeof(T));
+        }
+    }
+
+    std::string string()
+    {
+        const auto size = static_cast<std::size_t>(value<std::uint64_t>());
+        const auto* data = take(size);
+
+        return std::string{ reinterpret_cast<const char*>(data), size };
+    }
+
+    bool atEnd() const noexcept { return cursor == end; }
+
+    // return the number of bytes left to read
+    std::size_t remaining() const noexcept { return static_cast<std::size_t>(end - cursor); }
+
+private:
+    const unsigned char* begin;
+    const unsigned char* cursor;
+    const unsigned char* end;
+
+private:
+    const unsigned char* take(std::size_t size)
+    {
+        if(size > static_cast<std::size_t>(end - cursor))
+        {
+            throw std::runtime_error{ "snapshot is truncated" };
+        }
+
+        const unsigned char* data = cursor;
+        cursor += size;
+
+        return data;
+    }
+};
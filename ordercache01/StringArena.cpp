@@ -0,0 +1,116 @@
+#include "StringArena.h"
+
+#include <cstring>
+#include <utility>
+
+StringArena::StringArena(StringArena&& other) noexcept :
+    chunks{ std::move(other.chunks) },
+    chunk_bytes{ std::exchange(other.chunk_bytes, 0) },
+    used_bytes{ std::exchange(other.used_bytes, 0) },
+    next{ std::exchange(other.next, nullptr) },
+    left{ std::exchange(other.left, 0) },
+    free_blocks{ std::move(other.free_blocks) }
+{
+    other.chunks.clear();
+    other.free_blocks.clear();
+}
+
+StringArena& StringArena::operator = (StringArena&& other) noexcept
+{
+    if(this != &other)
+    {
+        chunks = std::move(other.chunks);
+        chunk_bytes = std::exchange(other.chunk_bytes, 0);
+        used_bytes = std::exchange(other.used_bytes, 0);
+        next = std::exchange(other.next, nullptr);
+        left = std::exchange(other.left, 0);
+        free_blocks = std::move(other.free_blocks);
+
+        other.chunks.clear();
+        other.free_blocks.clear();
+    }
+
+    return *this;
+}
+
+std::string_view StringArena::store(std::string_view s)
+{
+    if(s.empty())
+    {
+        return {};
+    }
+
+    char* block = allocate(sizeClass(s.size()));
+
+    std::memcpy(block, s.data(), s.size());
+
+    return { block, s.size() };
+}
+
+void StringArena::release(std::string_view s) noexcept
+{
+    if(s.empty())
+    {
+        return;
+    }
+
+    const std::size_t size_class = sizeClass(s.size());
+
+    // Only called for strings from store, whose class has a free list already.
+    char* block = const_cast<char*>(s.data());
+
+    std::memcpy(block, &free_blocks[size_class], sizeof(char*));
+    free_blocks[size_class] = block;
+
+    used_bytes -= size_class * granule;
+}
+
+void StringArena::clear() noexcept
+{
+    chunks.clear();
+    chunk_bytes = 0;
+    used_bytes = 0;
+
+    next = nullptr;
+    left = 0;
+
+    free_blocks.clear();
+}
+
+char* StringArena::allocate(std::size_t size_class)
+{
+    if(size_class >= free_blocks.size())
+    {
+        free_blocks.resize(size_class + 1, nullptr);
+    }
+
+    used_bytes += size_class * granule;
+
+    if(char* block = free_blocks[size_class])
+    {
+        std::memcpy(&free_blocks[size_class], block, sizeof(char*));
+
+        return block;
+    }
+
+    const std::size_t size = size_class * granule;
+
+    if(size > left)
+    {
+        // The tail of the full chunk is lost; strings are small next to a chunk.
+        const std::size_t new_chunk_size = size > chunk_size ? size : chunk_size;
+
+        chunks.push_back(std::make_unique<char[]>(new_chunk_size));
+        chunk_bytes += new_chunk_size;
+
+        next = chunks.back().get();
+        left = new_chunk_size;
+    }
+
+    char* block = next;
+
+    next += size;
+    left -= size;
+
+    return block;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+// Holds strings in large chunks, so that storing and releasing a string does not go to the heap.
+// A released block goes to the free list of its size class, for the next string of that class.
+// Memory goes back to the heap only a whole chunk at a time, on clear or destruction.
+class StringArena
+{
+public:
+    StringArena() = default;
+
+    StringArena(StringArena&& other) noexcept;
+    StringArena& operator = (StringArena&& other) noexcept;
+
+    // copy the string into the arena and return a view of the copy, valid until released
+    std::string_view store(std::string_view s);
+
+    // give the block of a string returned by store back to the arena
+    void release(std::string_view s) noexcept;
+
+    // release every string at once and free the chunks
+    void clear() noexcept;
+
+    // return the number of bytes held in chunks, in use or free
+    std::size_t capacity() const noexcept { return chunk_bytes; }
+
+    // return the number of bytes in the blocks of the strings stored and not released
+    std::size_t usedBytes() const noexcept { return used_bytes; }
+
+private:
+    // Blocks are multiples of the granule, which is large enough to link a free block.
+    static constexpr std::size_t granule = sizeof(char*);
+    static constexpr std::size_t chunk_size = 64 * 1024;
+
+    static std::size_t sizeClass(std::size_t length) noexcept { return (length + granule - 1) / granule; }
+
+    char* allocate(std::size_t size_class);
+
+    std::vector<std::unique_ptr<char[]>> chunks;
+    std::size_t chunk_bytes = 0;
+    std::size_t used_bytes = 0;
+
+    // Unused tail of the last chunk.
+    char* next = nullptr;
+    std::size_t left = 0;
+
+    // Head of the free list of each size class; each free block starts with the next one.
+    std::vector<char*> free_blocks;
+};
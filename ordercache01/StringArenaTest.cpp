@@ -0,0 +1,65 @@
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include "StringArena.h"
+
+TEST(StringArenaTest, StoresCopiesOfStrings)
+{
+    StringArena arena;
+
+    std::vector<std::string> originals;
+    std::vector<std::string_view> copies;
+
+    for(int i = 0; i < 10000; ++i)
+    {
+        originals.push_back("OrderWithALongIdentifier" + std::to_string(i));
+        copies.push_back(arena.store(originals.back()));
+    }
+
+    for(std::size_t i = 0; i < originals.size(); ++i)
+    {
+        EXPECT_EQ(copies[i], originals[i]);
+        EXPECT_NE(copies[i].data(), originals[i].data());
+    }
+
+    EXPECT_TRUE(arena.store("").empty());
+    EXPECT_EQ(arena.store(std::string(100000, 'x')), std::string(100000, 'x'));
+}
+
+TEST(StringArenaTest, ReusesReleasedBlocks)
+{
+    StringArena arena;
+
+    std::vector<std::string_view> copies;
+
+    for(int i = 0; i < 10000; ++i)
+    {
+        copies.push_back(arena.store("OrderWithALongIdentifier" + std::to_string(i)));
+    }
+
+    const std::size_t capacity = arena.capacity();
+
+    // Strings of the same size class fit the released blocks, so the arena does not grow.
+    for(int round = 0; round < 10; ++round)
+    {
+        for(std::string_view& copy : copies)
+        {
+            arena.release(copy);
+        }
+
+        for(std::size_t i = 0; i < copies.size(); ++i)
+        {
+            copies[i] = arena.store("OrderWithALongIdentifier" + std::to_string(copies.size() - i));
+        }
+    }
+
+    EXPECT_EQ(arena.capacity(), capacity);
+    EXPECT_EQ(copies.back(), "OrderWithALongIdentifier1");
+
+    arena.clear();
+
+    EXPECT_EQ(arena.capacity(), 0u);
+    EXPECT_EQ(arena.store("o1"), "o1");
+}
@@ -0,0 +1,58 @@
+#include "SymbolTable.h"
+#include "Snapshot.h"
+
+#include <stdexcept>
+
+SymbolId SymbolTable::intern(const std::string& name)
+{
+    const auto [it_id, inserted] = ids.try_emplace(name, static_cast<SymbolId>(names.size()));
+
+    if(inserted)
+    {
+        names.push_back(&it_id->first);
+    }
+
+    return it_id->second;
+}
+
+SymbolId SymbolTable::find(const std::string& name) const
+{
+    const auto it_id = ids.find(name);
+
+    return it_id != ids.end() ? it_id->second : none;
+}
+
+void SymbolTable::save(SnapshotWriter& writer) const
+{
+    writer.value(static_cast<std::uint64_t>(names.size()));
+
+    for(const std::string* name : names)
+    {
+        writer.string(*name);
+    }
+}
+
+void SymbolTable::load(SnapshotReader& reader)
+{
+    ids.clear();
+    names.clear();
+
+    const auto count = reader.value<std::uint64_t>();
+
+    // Each name takes its size at least.
+    if(count > reader.remaining() / sizeof(std::uint64_t))
+    {
+        throw std::runtime_error{ "snapshot is truncated" };
+    }
+
+    ids.reserve(static_cast<std::size_t>(count));
+    names.reserve(static_cast<std::size_t>(count));
+
+    for(std::uint64_t i = 0; i < count; ++i)
+    {
+        if(intern(reader.string()) != i)
+        {
+            throw std::runtime_error{ "snapshot has a repeated name" };
+        }
+    }
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using SymbolId = std::uint32_t;
+
+class SnapshotReader;
+class SnapshotWriter;
+
+// Maps names (securities, users, companies) to dense ids and back.
+// Ids are assigned in order of first appearance and are never reused.
+class SymbolTable
+{
+public:
+    static constexpr SymbolId none = std::numeric_limits<SymbolId>::max();
+
+    // return the id of the name, assigning the next free id to a name seen for the first time
+    SymbolId intern(const std::string& name);
+
+    // return the id of the name or none if the name has never been interned
+    SymbolId find(const std::string& name) const;
+
+    // return the name of an interned id
+    const std::string& name(SymbolId id) const { return *names[id]; }
+
+    // return the number of interned names
+    std::size_t size() const noexcept { return names.size(); }
+
+    // write the names to a snapshot, in id order
+    void save(SnapshotWriter& writer) const;
+
+    // replace the names with the ones of a snapshot
+    void load(SnapshotReader& reader);
+
+private:
+    std::unordered_map<std::string, SymbolId> ids;
+
+    // Points to the keys of ids, which stay put when the table grows.
+    std::vector<const std::string*> names;
+};
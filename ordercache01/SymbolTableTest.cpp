@@ -0,0 +1,38 @@
+#include <gtest/gtest.h>
+
+#include "SymbolTable.h"
+
+TEST(SymbolTableTest, AssignsDenseIdsInOrderOfFirstAppearance)
+{
+    SymbolTable symbols;
+
+    EXPECT_EQ(symbols.intern("SecId1"), 0u);
+    EXPECT_EQ(symbols.intern("SecId2"), 1u);
+    EXPECT_EQ(symbols.intern("SecId1"), 0u);
+    EXPECT_EQ(symbols.intern("SecId3"), 2u);
+
+    EXPECT_EQ(symbols.size(), 3u);
+}
+
+TEST(SymbolTableTest, MapsIdsBackToNames)
+{
+    SymbolTable symbols;
+
+    for(int i = 0; i < 1000; ++i)
+    {
+        symbols.intern("CompanyWithAVeryLongName" + std::to_string(i));
+    }
+
+    EXPECT_EQ(symbols.name(0), "CompanyWithAVeryLongName0");
+    EXPECT_EQ(symbols.name(999), "CompanyWithAVeryLongName999");
+    EXPECT_EQ(symbols.find("CompanyWithAVeryLongName500"), 500u);
+}
+
+TEST(SymbolTableTest, FindsNoIdForUnknownName)
+{
+    SymbolTable symbols;
+    symbols.intern("User1");
+
+    EXPECT_EQ(symbols.find("User2"), SymbolTable::none);
+    EXPECT_EQ(symbols.size(), 1u);
+}
@@ -0,0 +1,60 @@
+#include "AllocationCounter.h"
+
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+    thread_local std::size_t allocations = 0;
+}
+
+std::size_t allocationCount() noexcept
+{
+    return allocations;
+}
+
+void* operator new(std::size_t size)
+{
+    ++allocations;
+
+    if(void* p = std::malloc(size ? size : 1))
+    {
+        return p;
+    }
+
+    throw std::bad_alloc{};
+}
+
+void* operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment)
+{
+    ++allocations;
+
+    const auto align = static_cast<std::size_t>(alignment);
+
+    // aligned_alloc wants the size to be a multiple of the alignment.
+    if(void* p = std::aligned_alloc(align, (size + align - 1) / align * align))
+    {
+        return p;
+    }
+
+    throw std::bad_alloc{};
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment)
+{
+    return operator new(size, alignment);
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+void operator delete(void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept { std::free(p); }
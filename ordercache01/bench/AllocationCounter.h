@@ -0,0 +1,7 @@
+#pragma once
+
+#include <cstddef>
+
+// Number of heap allocations made so far by the calling thread.
+// Counted by the replacement operator new of the benchmark program.
+std::size_t allocationCount() noexcept;
@@ -0,0 +1,131 @@
+#include <benchmark/benchmark.h>
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "OrderCache.h"
+#include "Workload.h"
+
+/*
+   Matching sizes of every security after a company's orders were cancelled and added back,
+   which changes most books: a loop of getMatchingSizeForSecurity against the bulk query on
+   1 to 32 threads. Items are securities.
+*/
+
+namespace
+{
+    WorkloadParams bulkParams()
+    {
+        WorkloadParams params;
+
+        params.orders = 1000000;
+        params.securities = 50000;
+        params.users = 500;
+        params.companies = 10;
+
+        return params;
+    }
+
+    struct BulkWorkload
+    {
+        OrderCache cache;
+        std::vector<std::string> security_ids;
+
+        // Orders of the company whose cancel and re-add changes the books between iterations.
+        std::vector<Order> company_orders;
+
+        BulkWorkload()
+        {
+            const WorkloadParams params = bulkParams();
+            const std::vector<Order> orders = makeOrders(params);
+
+            cache.addOrders(orders);
+
+            for(int s = 0; s < params.securities; ++s)
+            {
+                security_ids.push_back(securityName(s));
+            }
+
+            for(const Order& order : orders)
+            {
+                if(order.company() == companyName(0))
+                {
+                    company_orders.push_back(order);
+                }
+            }
+        }
+
+        void changeBooks()
+        {
+            cache.cancelOrdersForCompany(companyName(0));
+            cache.addOrders(company_orders);
+        }
+    };
+
+    BulkWorkload& bulkWorkload()
+    {
+        static BulkWorkload workload;
+
+        return workload;
+    }
+
+    void BM_MatchingSizeLoop(benchmark::State& state)
+    {
+        BulkWorkload& workload = bulkWorkload();
+
+        for(auto _ : state)
+        {
+            state.PauseTiming();
+            workload.changeBooks();
+            state.ResumeTiming();
+
+            for(const std::string& security_id : workload.security_ids)
+            {
+                benchmark::DoNotOptimize(workload.cache.getMatchingSizeForSecurity(security_id));
+            }
+        }
+
+        state.SetItemsProcessed(state.iterations() * static_cast<std::int64_t>(workload.security_ids.size()));
+    }
+
+    void BM_MatchingSizeForAllSecurities(benchmark::State& state)
+    {
+        BulkWorkload& workload = bulkWorkload();
+
+        const auto threads = static_cast<std::size_t>(state.range(0));
+
+        for(auto _ : state)
+        {
+            state.PauseTiming();
+            workload.changeBooks();
+            state.ResumeTiming();
+
+            benchmark::DoNotOptimize(workload.cache.getMatchingSizeForAllSecurities(threads));
+        }
+
+        state.SetItemsProcessed(state.iterations() * static_cast<std::int64_t>(workload.security_ids.size()));
+    }
+
+    void BM_MatchingSizeForSecurities(benchmark::State& state)
+    {
+        BulkWorkload& workload = bulkWorkload();
+
+        const auto threads = static_cast<std::size_t>(state.range(0));
+
+        for(auto _ : state)
+        {
+            state.PauseTiming();
+            workload.changeBooks();
+            state.ResumeTiming();
+
+            benchmark::DoNotOptimize(workload.cache.getMatchingSizeForSecurities(workload.security_ids, threads));
+        }
+
+        state.SetItemsProcessed(state.iterations() * static_cast<std::int64_t>(workload.security_ids.size()));
+    }
+}
+
+BENCHMARK(BM_MatchingSizeLoop)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK(BM_MatchingSizeForAllSecurities)->ArgName("threads")->RangeMultiplier(2)->Range(1, 32)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK(BM_MatchingSizeForSecurities)->ArgName("threads")->RangeMultiplier(2)->Range(1, 32)->Unit(benchmark::kMillisecond)->UseRealTime();
@@ -0,0 +1,121 @@
+#include <benchmark/benchmark.h>
+
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "JournaledOrderCache.h"
+#include "OpStats.h"
+#include "Workload.h"
+
+// The cost of journaling on the write path: each iteration adds a new order and cancels the
+// oldest one, on a plain OrderCache and on a JournaledOrderCache with and without fdatasync.
+// Arguments: group_records, group_interval in microseconds.
+
+namespace
+{
+    enum class Journaling
+    {
+        Off,
+        Buffered,
+        Synced,
+    };
+
+    const std::string snapshot_path = "ordercache01_bench.journal.snap";
+    const std::string journal_path = "ordercache01_bench.journal";
+
+    // Returns the concrete type: OrderCacheInterface has no virtual destructor.
+    template <Journaling journaling>
+    auto makeCache(const benchmark::State& state)
+    {
+        if constexpr(Journaling::Off == journaling)
+        {
+            return std::make_unique<OrderCache>();
+        }
+        else
+        {
+            std::filesystem::remove(snapshot_path);
+            std::filesystem::remove(journal_path);
+
+            JournalOptions options;
+            options.group_records = static_cast<std::size_t>(state.range(0));
+            options.group_interval = std::chrono::microseconds{ state.range(1) };
+            options.sync = Journaling::Synced == journaling;
+
+            return std::make_unique<JournaledOrderCache>(snapshot_path, journal_path, options);
+        }
+    }
+
+    template <Journaling journaling>
+    void BM_JournaledAddCancel(benchmark::State& state)
+    {
+        WorkloadParams params;
+        params.orders = 400000;
+        params.securities = 1000;
+        params.users = 500;
+        params.companies = 20;
+
+        const auto stream = makeOrders(params);
+        constexpr std::size_t resting = 10000;
+
+        std::vector<std::string> order_ids;
+
+        for(const auto& order : stream)
+        {
+            order_ids.push_back(order.orderId());
+        }
+
+        auto cache = makeCache<journaling>(state);
+
+        for(std::size_t i = 0; i < resting; ++i)
+        {
+            cache->addOrder(stream[i]);
+        }
+
+        std::size_t next = resting;
+        OpStats stats;
+
+        for(auto _ : state)
+        {
+            if(next == stream.size())
+            {
+                state.PauseTiming();
+                cache.reset();
+                cache = makeCache<journaling>(state);
+                next = 0;
+                state.ResumeTiming();
+            }
+
+            stats.measure([&]
+            {
+                cache->addOrder(stream[next]);
+
+                if(next >= resting)
+                {
+                    cache->cancelOrder(order_ids[next - resting]);
+                }
+            });
+
+            ++next;
+        }
+
+        stats.report(state);
+
+        cache.reset();
+        std::filesystem::remove(snapshot_path);
+        std::filesystem::remove(journal_path);
+    }
+
+    void groups(benchmark::internal::Benchmark* b)
+    {
+        b->ArgNames({ "group", "interval_us" });
+
+        b->Args({ 64, 200 });
+        b->Args({ 1024, 1000 });
+    }
+}
+
+BENCHMARK_TEMPLATE(BM_JournaledAddCancel, Journaling::Off)->Args({ 0, 0 })->ArgNames({ "group", "interval_us" });
+BENCHMARK_TEMPLATE(BM_JournaledAddCancel, Journaling::Buffered)->Apply(groups);
+BENCHMARK_TEMPLATE(BM_JournaledAddCancel, Journaling::Synced)->Apply(groups);
@@ -0,0 +1,91 @@
+#include <benchmark/benchmark.h>
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ShardedOrderCache.h"
+
+// Readers query matching sizes while one writer thread keeps adding and cancelling orders.
+
+namespace
+{
+    constexpr int securities = 1000;
+    constexpr int resting_orders = 20000;
+
+    std::unique_ptr<ShardedOrderCache> cache;
+    std::vector<std::string> security_ids;
+
+    std::atomic<bool> writer_done{ false };
+    std::thread writer;
+
+    Order makeOrder(int i)
+    {
+        return { "o" + std::to_string(i), security_ids[i % securities], i % 2 ? "Buy" : "Sell",
+            static_cast<unsigned int>(100 + i % 900), "u" + std::to_string(i % 50), "c" + std::to_string(i % 13) };
+    }
+
+    void startWriter(ShardedOrderCache::MatchingReads matching_reads)
+    {
+        security_ids.clear();
+
+        for(int s = 0; s < securities; ++s)
+        {
+            security_ids.push_back("SecId" + std::to_string(s));
+        }
+
+        cache = std::make_unique<ShardedOrderCache>(16, matching_reads);
+
+        for(int i = 0; i < resting_orders; ++i)
+        {
+            cache->addOrder(makeOrder(i));
+        }
+
+        writer_done = false;
+        writer = std::thread{ []
+        {
+            // Replace the oldest resting order with a new one, over and over.
+            for(int i = resting_orders; !writer_done; ++i)
+            {
+                cache->cancelOrder("o" + std::to_string(i - resting_orders));
+                cache->addOrder(makeOrder(i));
+            }
+        } };
+    }
+
+    void stopWriter()
+    {
+        writer_done = true;
+        writer.join();
+        cache.reset();
+    }
+
+    template <ShardedOrderCache::MatchingReads matching_reads>
+    void BM_ReadMatchingSize(benchmark::State& state)
+    {
+        if(0 == state.thread_index())
+        {
+            startWriter(matching_reads);
+        }
+
+        unsigned int s = static_cast<unsigned int>(state.thread_index()) * 7919;
+
+        for(auto _ : state)
+        {
+            benchmark::DoNotOptimize(cache->readMatchingSizeForSecurity(security_ids[s++ % securities]));
+        }
+
+        state.SetItemsProcessed(state.iterations());
+
+        if(0 == state.thread_index())
+        {
+            stopWriter();
+        }
+    }
+}
+
+BENCHMARK_TEMPLATE(BM_ReadMatchingSize, ShardedOrderCache::MatchingReads::Locked)->ThreadRange(1, 16)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_ReadMatchingSize, ShardedOrderCache::MatchingReads::Published)->ThreadRange(1, 16)->UseRealTime();
+
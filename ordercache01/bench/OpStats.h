@@ -0,0 +1,65 @@
+#pragma once
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "AllocationCounter.h"
+
+// Times single operations and counts their allocations, then reports
+// allocations/op and p50/p99/p999 latency as benchmark counters.
+class OpStats
+{
+public:
+    OpStats()
+    {
+        latencies.reserve(1 << 20);
+    }
+
+    template <typename Op>
+    void measure(Op&& op)
+    {
+        const std::size_t allocations_before = allocationCount();
+        const auto start = std::chrono::steady_clock::now();
+
+        op();
+
+        const auto stop = std::chrono::steady_clock::now();
+
+        allocations += allocationCount() - allocations_before;
+        latencies.push_back(static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start).count()));
+    }
+
+    void report(benchmark::State& state)
+    {
+        if(latencies.empty())
+        {
+            return;
+        }
+
+        const double ops = static_cast<double>(latencies.size());
+
+        state.counters["allocs/op"] = static_cast<double>(allocations) / ops;
+        state.counters["p50_ns"] = percentile(0.50);
+        state.counters["p99_ns"] = percentile(0.99);
+        state.counters["p999_ns"] = percentile(0.999);
+    }
+
+private:
+    std::vector<std::uint64_t> latencies;
+    std::size_t allocations = 0;
+
+private:
+    double percentile(double p)
+    {
+        const auto rank = static_cast<std::size_t>(p * static_cast<double>(latencies.size() - 1));
+
+        std::nth_element(latencies.begin(), latencies.begin() + rank, latencies.end());
+
+        return static_cast<double>(latencies[rank]);
+    }
+};
@@ -0,0 +1,542 @@
+#include <benchmark/benchmark.h>
+
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "OpStats.h"
+#include "OrderCache.h"
+#include "ShardedOrderCache.h"
+#include "Workload.h"
+
+/*
+   One benchmark per OrderCacheInterface method plus mixed workloads, for OrderCache and ShardedOrderCache.
+   Arguments: orders, securities, users, companies, zipf exponent * 100.
+
+   Time is ns/op. Counters add allocs/op and p50/p99/p999 latency in ns.
+   For trend tracking: ./ordercache01_bench --benchmark_out=bench.json --benchmark_out_format=json
+*/
+
+namespace
+{
+    WorkloadParams paramsOf(const benchmark::State& state)
+    {
+        WorkloadParams params;
+
+        params.orders = static_cast<int>(state.range(0));
+        params.securities = static_cast<int>(state.range(1));
+        params.users = static_cast<int>(state.range(2));
+        params.companies = static_cast<int>(state.range(3));
+        params.zipf = static_cast<double>(state.range(4)) / 100.0;
+
+        return params;
+    }
+
+    void workloads(benchmark::internal::Benchmark* b)
+    {
+        b->ArgNames({ "orders", "secs", "users", "comps", "zipf" });
+
+        b->Args({   10000,  100,   50, 10,   0 });
+        b->Args({  200000, 1000,  500, 20,   0 });
+        b->Args({  200000, 1000,  500, 20, 120 });
+    }
+
+    template <typename Cache>
+    std::unique_ptr<Cache> makeCache(const std::vector<Order>& orders)
+    {
+        auto cache = std::make_unique<Cache>();
+
+        for(const auto& order : orders)
+        {
+            cache->addOrder(order);
+        }
+
+        return cache;
+    }
+
+    template <typename Cache>
+    void BM_AddOrder(benchmark::State& state)
+    {
+        const auto orders = makeOrders(paramsOf(state));
+
+        auto cache = std::make_unique<Cache>();
+        std::size_t next = 0;
+
+        OpStats stats;
+
+        for(auto _ : state)
+        {
+            if(next == orders.size())
+            {
+                state.PauseTiming();
+                cache = std::make_unique<Cache>();
+                next = 0;
+                state.ResumeTiming();
+            }
+
+            stats.measure([&] { cache->addOrder(orders[next++]); });
+        }
+
+        stats.report(state);
+    }
+
+    template <typename Cache>
+    void BM_CancelOrder(benchmark::State& state)
+    {
+        const auto orders = makeOrders(paramsOf(state));
+
+        std::vector<std::string> order_ids;
+
+        for(const auto& order : orders)
+        {
+            order_ids.push_back(order.orderId());
+        }
+
+        auto cache = makeCache<Cache>(orders);
+        std::size_t next = 0;
+
+        OpStats stats;
+
+        for(auto _ : state)
+        {
+            if(next == orders.size())
+            {
+                state.PauseTiming();
+                cache = makeCache<Cache>(orders);
+                next = 0;
+                state.ResumeTiming();
+            }
+
+            stats.measure([&] { cache->cancelOrder(order_ids[next++]); });
+        }
+
+        stats.report(state);
+    }
+
+    template <typename Cache>
+    void BM_CancelOrdersForUser(benchmark::State& state)
+    {
+        const auto params = paramsOf(state);
+        const auto orders = makeOrders(params);
+
+        auto cache = makeCache<Cache>(orders);
+        int next = 0;
+
+        OpStats stats;
+
+        for(auto _ : state)
+        {
+            if(next == params.users)
+            {
+                state.PauseTiming();
+                cache = makeCache<Cache>(orders);
+                next = 0;
+                state.ResumeTiming();
+            }
+
+            const std::string user = userName(next++);
+
+            stats.measure([&] { cache->cancelOrdersForUser(user); });
+        }
+
+        stats.report(state);
+    }
+
+    template <typename Cache>
+    void BM_CancelOrdersForSecIdWithMinimumQty(benchmark::State& state)
+    {
+        const auto params = paramsOf(state);
+        const auto orders = makeOrders(params);
+
+        auto cache = makeCache<Cache>(orders);
+        int next = 0;
+
+        OpStats stats;
+
+        for(auto _ : state)
+        {
+            if(next == params.securities)
+            {
+                state.PauseTiming();
+                cache = makeCache<Cache>(orders);
+                next = 0;
+                state.ResumeTiming();
+            }
+
+            const std::string security = securityName(next++);
+
+            // Cancel about the top tenth of the qty range.
+            stats.measure([&] { cache->cancelOrdersForSecIdWithMinimumQty(security, 900); });
+        }
+
+        stats.report(state);
+    }
+
+    template <typename Cache>
+    void BM_GetMatchingSizeForSecurity(benchmark::State& state)
+    {
+        const auto params = paramsOf(state);
+        const auto orders = makeOrders(params);
+
+        auto cache = makeCache<Cache>(orders);
+
+        std::vector<std::string> securities;
+
+        for(int s = 0; s < params.securities; ++s)
+        {
+            securities.push_back(securityName(s));
+        }
+
+        std::size_t next = 0;
+
+        OpStats stats;
+
+        for(auto _ : state)
+        {
+            const std::string& security = securities[next++ % securities.size()];
+
+            stats.measure([&] { benchmark::DoNotOptimize(cache->getMatchingSizeForSecurity(security)); });
+        }
+
+        stats.report(state);
+    }
+
+    template <typename Cache>
+    void BM_GetAllOrders(benchmark::State& state)
+    {
+        const auto orders = makeOrders(paramsOf(state));
+
+        auto cache = makeCache<Cache>(orders);
+
+        OpStats stats;
+
+        for(auto _ : state)
+        {
+            stats.measure([&] { benchmark::DoNotOptimize(cache->getAllOrders()); });
+        }
+
+        stats.report(state);
+        state.SetItemsProcessed(state.iterations() * static_cast<std::int64_t>(orders.size()));
+    }
+
+    // The same walk as getAllOrders, through views instead of copies.
+    template <typename Cache>
+    void BM_ForEachOrder(benchmark::State& state)
+    {
+        const auto orders = makeOrders(paramsOf(state));
+
+        auto cache = makeCache<Cache>(orders);
+
+        OpStats stats;
+
+        for(auto _ : state)
+        {
+            stats.measure([&]
+            {
+                unsigned long long qty = 0;
+                cache->forEachOrder([&qty](const OrderView& order) { qty += order.qty; });
+                benchmark::DoNotOptimize(qty);
+            });
+        }
+
+        stats.report(state);
+        state.SetItemsProcessed(state.iterations() * static_cast<std::int64_t>(orders.size()));
+    }
+
+    // Session open: rebuild the cache from all live orders, one call per order or one batch.
+    void BM_ReplayAddOrder(benchmark::State& state)
+    {
+        const auto orders = makeOrders(paramsOf(state));
+
+        for(auto _ : state)
+        {
+            OrderCache cache;
+
+            for(const auto& order : orders)
+            {
+                cache.addOrder(order);
+            }
+
+            benchmark::DoNotOptimize(cache);
+        }
+
+        state.SetItemsProcessed(state.iterations() * static_cast<std::int64_t>(orders.size()));
+    }
+
+    void BM_ReplayAddOrders(benchmark::State& state)
+    {
+        const auto orders = makeOrders(paramsOf(state));
+
+        for(auto _ : state)
+        {
+            OrderCache cache;
+
+            cache.addOrders(orders);
+
+            benchmark::DoNotOptimize(cache);
+        }
+
+        state.SetItemsProcessed(state.iterations() * static_cast<std::int64_t>(orders.size()));
+    }
+
+    enum class FillBy { CancelAndAdd, ReduceQty };
+
+    // Partial fills of one lot each, round robin over the orders; an order down to one lot is
+    // amended back to its qty. Filled in place with reduceQty and amendQty, or by cancelling the
+    // order and adding it again with the new qty.
+    template <typename Cache, FillBy fill_by>
+    void BM_PartialFill(benchmark::State& state)
+    {
+        const auto orders = makeOrders(paramsOf(state));
+
+        auto cache = makeCache<Cache>(orders);
+
+        std::vector<unsigned int> qty;
+
+        for(const auto& order : orders)
+        {
+            qty.push_back(order.qty());
+        }
+
+        std::size_t next = 0;
+
+        OpStats stats;
+
+        for(auto _ : state)
+        {
+            const Order& order = orders[next];
+
+            const unsigned int new_qty = qty[next] > 1 ? qty[next] - 1 : order.qty();
+
+            if constexpr(FillBy::ReduceQty == fill_by)
+            {
+                stats.measure([&]
+                {
+                    if(new_qty < qty[next])
+                    {
+                        cache->reduceQty(order.orderId(), 1);
+                    }
+                    else
+                    {
+                        cache->amendQty(order.orderId(), new_qty);
+                    }
+                });
+            }
+            else
+            {
+                stats.measure([&]
+                {
+                    cache->cancelOrder(order.orderId());
+                    cache->addOrder({ order.orderId(), order.securityId(), order.side(), new_qty, order.user(), order.company() });
+                });
+            }
+
+            qty[next] = new_qty;
+            next = (next + 1) % orders.size();
+        }
+
+        stats.report(state);
+    }
+
+    // A min-qty cancel of a few large orders in a security of many small ones.
+    // Argument: orders resting in the security.
+    void BM_CancelFewOfDeepSecurity(benchmark::State& state)
+    {
+        const auto resting = static_cast<int>(state.range(0));
+
+        OrderCache cache;
+
+        for(int i = 0; i < resting; ++i)
+        {
+            cache.addOrder({ "OrdId" + std::to_string(i), "SecId0", i % 2 ? "Buy" : "Sell",
+                static_cast<unsigned int>(1 + i % 1000), userName(i % 100), companyName(i % 10) });
+        }
+
+        std::vector<Order> large;
+
+        for(int i = 0; i < 10; ++i)
+        {
+            large.push_back({ "Large" + std::to_string(i), "SecId0", i % 2 ? "Buy" : "Sell", 5000, userName(i), companyName(i) });
+        }
+
+        for(auto _ : state)
+        {
+            state.PauseTiming();
+            cache.addOrders(large);
+            state.ResumeTiming();
+
+            cache.cancelOrdersForSecIdWithMinimumQty("SecId0", 5000);
+        }
+
+        state.SetItemsProcessed(state.iterations() * static_cast<std::int64_t>(large.size()));
+    }
+
+    // Compaction after an end of day sweep cancelled the orders of all users but one, in calls of
+    // 4096 units of work. Items are compact calls; counters add the memory before and after the pass.
+    void BM_CompactAfterSweep(benchmark::State& state)
+    {
+        const auto params = paramsOf(state);
+        const auto orders = makeOrders(params);
+
+        std::size_t bytes_before = 0;
+        std::size_t bytes_after = 0;
+
+        OpStats stats;
+
+        for(auto _ : state)
+        {
+            state.PauseTiming();
+
+            auto cache = makeCache<OrderCache>(orders);
+
+            for(int user = 1; user < params.users; ++user)
+            {
+                cache->cancelOrdersForUser(userName(user));
+            }
+
+            bytes_before = cache->memoryBytes();
+
+            state.ResumeTiming();
+
+            for(bool done = false; !done; )
+            {
+                stats.measure([&] { done = cache->compact().done; });
+            }
+
+            state.PauseTiming();
+            bytes_after = cache->memoryBytes();
+            cache.reset();
+            state.ResumeTiming();
+        }
+
+        stats.report(state);
+
+        state.counters["bytes_before"] = static_cast<double>(bytes_before);
+        state.counters["bytes_after"] = static_cast<double>(bytes_after);
+    }
+
+    // Warm start: rebuild the cache from a snapshot instead of replaying the orders.
+    void BM_LoadSnapshot(benchmark::State& state)
+    {
+        const std::string path = "ordercache01_bench.snap";
+
+        OrderCache source;
+        source.addOrders(makeOrders(paramsOf(state)));
+        source.saveSnapshot(path);
+
+        for(auto _ : state)
+        {
+            OrderCache cache;
+
+            cache.loadSnapshot(path);
+
+            benchmark::DoNotOptimize(cache);
+        }
+
+        std::remove(path.c_str());
+    }
+
+    // Keeps the book at a steady size: every add of a new order is paired with a cancel of the
+    // oldest one, and queries are spread over the securities as the workload skew says.
+    template <typename Cache>
+    void runMix(benchmark::State& state, int query_percent)
+    {
+        const auto params = paramsOf(state);
+
+        WorkloadParams stream_params = params;
+        stream_params.orders = params.orders * 4;
+
+        const auto stream = makeOrders(stream_params);
+
+        std::vector<std::string> order_ids;
+
+        for(const auto& order : stream)
+        {
+            order_ids.push_back(order.orderId());
+        }
+
+        const std::vector<Order> resting{ stream.begin(), stream.begin() + params.orders };
+
+        auto cache = makeCache<Cache>(resting);
+        std::size_t next = resting.size();
+
+        std::mt19937 rng{ 2 };
+        const ZipfDistribution pick_security{ params.securities, params.zipf };
+
+        std::vector<std::string> securities;
+
+        for(int s = 0; s < params.securities; ++s)
+        {
+            securities.push_back(securityName(s));
+        }
+
+        OpStats stats;
+        bool add_next = true;
+
+        for(auto _ : state)
+        {
+            if(next == stream.size())
+            {
+                state.PauseTiming();
+                cache = makeCache<Cache>(resting);
+                next = resting.size();
+                state.ResumeTiming();
+            }
+
+            if(static_cast<int>(rng() % 100) < query_percent)
+            {
+                const std::string& security = securities[pick_security(rng)];
+
+                stats.measure([&] { benchmark::DoNotOptimize(cache->getMatchingSizeForSecurity(security)); });
+            }
+            else if(add_next)
+            {
+                stats.measure([&] { cache->addOrder(stream[next]); });
+                add_next = false;
+            }
+            else
+            {
+                stats.measure([&] { cache->cancelOrder(order_ids[next - resting.size()]); });
+                ++next;
+                add_next = true;
+            }
+        }
+
+        stats.report(state);
+    }
+
+    template <typename Cache>
+    void BM_CancelHeavyMix(benchmark::State& state)
+    {
+        runMix<Cache>(state, 10);
+    }
+
+    template <typename Cache>
+    void BM_QueryHeavyMix(benchmark::State& state)
+    {
+        runMix<Cache>(state, 80);
+    }
+}
+
+#define ORDERCACHE_BENCHMARKS(Cache) \
+    BENCHMARK_TEMPLATE(BM_AddOrder, Cache)->Apply(workloads); \
+    BENCHMARK_TEMPLATE(BM_CancelOrder, Cache)->Apply(workloads); \
+    BENCHMARK_TEMPLATE(BM_CancelOrdersForUser, Cache)->Apply(workloads); \
+    BENCHMARK_TEMPLATE(BM_CancelOrdersForSecIdWithMinimumQty, Cache)->Apply(workloads); \
+    BENCHMARK_TEMPLATE(BM_GetMatchingSizeForSecurity, Cache)->Apply(workloads); \
+    BENCHMARK_TEMPLATE(BM_GetAllOrders, Cache)->Apply(workloads); \
+    BENCHMARK_TEMPLATE(BM_ForEachOrder, Cache)->Apply(workloads); \
+    BENCHMARK_TEMPLATE(BM_CancelHeavyMix, Cache)->Apply(workloads); \
+    BENCHMARK_TEMPLATE(BM_QueryHeavyMix, Cache)->Apply(workloads)
+
+ORDERCACHE_BENCHMARKS(OrderCache);
+BENCHMARK(BM_ReplayAddOrder)->Apply(workloads)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_ReplayAddOrders)->Apply(workloads)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_LoadSnapshot)->Apply(workloads)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_CancelFewOfDeepSecurity)->ArgName("orders")->Arg(1000)->Arg(100000);
+BENCHMARK_TEMPLATE(BM_PartialFill, OrderCache, FillBy::CancelAndAdd)->Apply(workloads);
+BENCHMARK_TEMPLATE(BM_PartialFill, OrderCache, FillBy::ReduceQty)->Apply(workloads);
+BENCHMARK(BM_CompactAfterSweep)->Apply(workloads)->Unit(benchmark::kMillisecond);
+ORDERCACHE_BENCHMARKS(ShardedOrderCache);
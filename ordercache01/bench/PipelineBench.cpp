@@ -0,0 +1,118 @@
+#include <benchmark/benchmark.h>
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "PipelinedOrderCache.h"
+
+/*
+   Producer threads share one cache: each adds an order, cancels the one it added 64 iterations
+   before and, every 64 iterations, waits for a matching size. The OrderCache behind a mutex
+   against the pipeline, whose owner thread applies every command. Items are producer
+   iterations; the waiting queries keep the owner from lagging far behind.
+*/
+
+namespace
+{
+    constexpr int securities = 1000;
+    constexpr int window = 64;
+
+    // The OrderCache shared by taking a lock around every call.
+    class LockedOrderCache : public OrderCacheInterface
+    {
+    public:
+        void addOrder(Order order) override
+        {
+            std::lock_guard<std::mutex> lock{ mutex };
+            cache.addOrder(std::move(order));
+        }
+
+        void cancelOrder(const std::string& orderId) override
+        {
+            std::lock_guard<std::mutex> lock{ mutex };
+            cache.cancelOrder(orderId);
+        }
+
+        void cancelOrdersForUser(const std::string& user) override
+        {
+            std::lock_guard<std::mutex> lock{ mutex };
+            cache.cancelOrdersForUser(user);
+        }
+
+        void cancelOrdersForSecIdWithMinimumQty(const std::string& securityId, unsigned int minQty) override
+        {
+            std::lock_guard<std::mutex> lock{ mutex };
+            cache.cancelOrdersForSecIdWithMinimumQty(securityId, minQty);
+        }
+
+        unsigned int getMatchingSizeForSecurity(const std::string& securityId) override
+        {
+            std::lock_guard<std::mutex> lock{ mutex };
+            return cache.getMatchingSizeForSecurity(securityId);
+        }
+
+        std::vector<Order> getAllOrders() const override
+        {
+            std::lock_guard<std::mutex> lock{ mutex };
+            return cache.getAllOrders();
+        }
+
+    private:
+        mutable std::mutex mutex;
+        OrderCache cache;
+    };
+
+    std::string securityId(int i)
+    {
+        return "SecId" + std::to_string(i % securities);
+    }
+
+    template <typename Cache>
+    std::unique_ptr<Cache> shared_cache;
+
+    template <typename Cache>
+    void BM_Producers(benchmark::State& state)
+    {
+        if(0 == state.thread_index())
+        {
+            shared_cache<Cache> = std::make_unique<Cache>();
+        }
+
+        const std::string prefix = "t" + std::to_string(state.thread_index()) + "-";
+        const std::string user = "u" + std::to_string(state.thread_index());
+
+        int i = 0;
+
+        for(auto _ : state)
+        {
+            Cache& cache = *shared_cache<Cache>;
+
+            cache.addOrder({ prefix + std::to_string(i), securityId(i * 7 + state.thread_index()), i % 2 ? "Buy" : "Sell",
+                static_cast<unsigned int>(100 + i % 900), user, "c1" });
+
+            if(i >= window)
+            {
+                cache.cancelOrder(prefix + std::to_string(i - window));
+            }
+
+            if(0 == i % window)
+            {
+                benchmark::DoNotOptimize(cache.getMatchingSizeForSecurity(securityId(i)));
+            }
+
+            ++i;
+        }
+
+        state.SetItemsProcessed(state.iterations());
+
+        if(0 == state.thread_index())
+        {
+            shared_cache<Cache>.reset();
+        }
+    }
+}
+
+BENCHMARK_TEMPLATE(BM_Producers, LockedOrderCache)->Threads(1)->Threads(4)->Threads(16)->Threads(64)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_Producers, PipelinedOrderCache)->Threads(1)->Threads(4)->Threads(16)->Threads(64)->UseRealTime();
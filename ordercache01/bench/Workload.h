@@ -0,0 +1,91 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "OrderCacheInterface.h"
+
+// Shape of a generated book of orders.
+struct WorkloadParams
+{
+    int orders = 100000;
+    int securities = 1000;
+    int users = 100;
+    int companies = 20;
+
+    // Zipf exponent of the security, user and company picks. 0 picks uniformly.
+    double zipf = 0.0;
+};
+
+// Picks ranks 0..n-1 with probability proportional to 1 / (rank + 1)^s.
+class ZipfDistribution
+{
+public:
+    ZipfDistribution(int n, double s)
+    {
+        cdf.reserve(n);
+
+        double sum = 0.0;
+
+        for(int rank = 0; rank < n; ++rank)
+        {
+            sum += 1.0 / std::pow(rank + 1.0, s);
+            cdf.push_back(sum);
+        }
+
+        for(auto& p : cdf)
+        {
+            p /= sum;
+        }
+    }
+
+    template <typename Rng>
+    int operator () (Rng& rng) const
+    {
+        const double u = std::uniform_real_distribution<double>{ 0.0, 1.0 }(rng);
+
+        const auto it = std::lower_bound(cdf.begin(), cdf.end(), u);
+
+        return static_cast<int>(std::min<std::ptrdiff_t>(it - cdf.begin(), cdf.size() - 1));
+    }
+
+private:
+    std::vector<double> cdf;
+};
+
+inline std::string securityName(int security) { return "SecId" + std::to_string(security); }
+inline std::string userName(int user) { return "User" + std::to_string(user); }
+inline std::string companyName(int company) { return "Company" + std::to_string(company); }
+
+// Orders with unique ids "OrdId<i>", qty in [1, 1000] and names picked as the params say.
+inline std::vector<Order> makeOrders(const WorkloadParams& params, std::uint32_t seed = 1)
+{
+    std::mt19937 rng{ seed };
+
+    const ZipfDistribution pick_security{ params.securities, params.zipf };
+    const ZipfDistribution pick_user{ params.users, params.zipf };
+    const ZipfDistribution pick_company{ params.companies, params.zipf };
+
+    std::uniform_int_distribution<unsigned int> pick_qty{ 1, 1000 };
+
+    std::vector<Order> orders;
+    orders.reserve(params.orders);
+
+    for(int i = 0; i < params.orders; ++i)
+    {
+        orders.emplace_back(
+            "OrdId" + std::to_string(i),
+            securityName(pick_security(rng)),
+            rng() % 2 ? "Buy" : "Sell",
+            pick_qty(rng),
+            userName(pick_user(rng)),
+            companyName(pick_company(rng))
+        );
+    }
+
+    return orders;
+}